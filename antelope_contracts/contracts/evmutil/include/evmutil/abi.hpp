@@ -0,0 +1,231 @@
+#pragma once
+
+#include <evmutil/types.hpp>
+#include <evmutil/keccak.hpp>
+#include <evmutil/address.hpp>
+#include <evmutil/precision.hpp>
+
+namespace evmutil {
+
+/// Kind of a static 32-byte word in bridge message call data.
+enum class abi_arg : uint8_t {
+    account,  // reserved address holding an exSat account name
+    address,  // plain 160-bit EVM address
+    amount,   // token amount in ERC-20 precision
+    uint,     // raw uint256
+    offset    // offset of dynamic data, relative to the first argument
+};
+
+/// Compile-time layout of a static tuple of words, as found in the elements of a dynamic array.
+template <abi_arg... Args>
+struct abi_tuple {
+    static_assert(sizeof...(Args) > 0, "abi tuples carry at least one argument");
+
+    static constexpr size_t   head_size = 0;
+    static constexpr size_t   arg_count = sizeof...(Args);
+    static constexpr size_t   min_size = 32 * arg_count;
+    static constexpr abi_arg  args[] = {Args...};
+
+    static constexpr size_t offset(size_t index) { return 32 * index; }
+};
+
+/// Compile-time layout of a bridge message call: a 4-byte selector followed by static words.
+template <uint32_t Selector, abi_arg... Args>
+struct abi_call {
+    static_assert(sizeof...(Args) > 0, "bridge message calls carry at least one argument");
+
+    static constexpr uint32_t selector = Selector;
+    static constexpr size_t   head_size = 4;
+    static constexpr size_t   arg_count = sizeof...(Args);
+    static constexpr size_t   min_size = head_size + 32 * arg_count;
+    static constexpr abi_arg  args[] = {Args...};
+
+    static constexpr size_t offset(size_t index) { return head_size + 32 * index; }
+};
+
+/// Reads the big-endian 4-byte selector at the start of call data.
+inline uint32_t read_selector(const byte_span &data) {
+    check(data.size() >= 4, "not enough data in bridge_message_v0");
+    return (uint32_t(uint8_t(data[0])) << 24) | (uint32_t(uint8_t(data[1])) << 16) |
+           (uint32_t(uint8_t(data[2])) << 8) | uint32_t(uint8_t(data[3]));
+}
+
+template <typename Elem>
+class abi_array_view;
+
+/// Typed view over call data laid out as `Layout`. The length is checked once on construction,
+/// after which every getter reads its word in place without copying.
+template <typename Layout>
+class abi_view {
+   public:
+    explicit abi_view(const byte_span &data) : abi_view((const uint8_t *)data.data(), data.size()) {
+        check(data.size() >= Layout::min_size, "not enough data in bridge_message_v0");
+    }
+
+    /// Raw uint256 argument. Amount words may also be read unscaled.
+    template <size_t I>
+    intx::uint256 get_uint() const {
+        static_assert(Layout::args[I] == abi_arg::uint || Layout::args[I] == abi_arg::amount, "argument is not a uint256");
+        return intx::be::unsafe::load<intx::uint256>(word<I>());
+    }
+
+    /// 160-bit EVM address argument.
+    template <size_t I>
+    checksum160 get_address() const {
+        static_assert(Layout::args[I] == abi_arg::address, "argument is not an address");
+        const uint8_t *w = word<I>();
+        check(is_filled(w, 32 - kAddressLength, 0), "invalid evm address");
+        return make_key160(w + 32 - kAddressLength, kAddressLength);
+    }
+
+    /// exSat account encoded as a reserved address: 12 bytes of 0xbb followed by the big-endian name.
+    template <size_t I>
+    uint64_t get_account() const {
+        static_assert(Layout::args[I] == abi_arg::account, "argument is not an exSat account");
+        const uint8_t *w = word<I>();
+        check(is_filled(w, 32 - kAddressLength, 0), "invalid evm address");
+        const auto account = extract_reserved_address(w + 32 - kAddressLength);
+        check(account.has_value(), "destination address in bridge_message_v0 must be reserved address");
+        return *account;
+    }
+
+    /// Token amount scaled down from ERC-20 precision to the native amount.
+    template <size_t I>
+    uint64_t get_amount(const precision_scale &scale) const {
+        static_assert(Layout::args[I] == abi_arg::amount, "argument is not a token amount");
+        return to_native_amount(intx::be::unsafe::load<intx::uint256>(word<I>()), scale);
+    }
+
+    /// Dynamic array of `Elem` tuples located through an offset argument, bounds-checked as a whole.
+    template <size_t I, typename Elem>
+    abi_array_view<Elem> get_array(size_t max_count) const {
+        static_assert(Layout::args[I] == abi_arg::offset, "argument is not a dynamic data offset");
+        const size_t avail = _size - Layout::head_size;
+
+        intx::uint256 value = intx::be::unsafe::load<intx::uint256>(word<I>());
+        check(avail >= 32 && value <= avail - 32, "invalid offset of dynamic data");
+        const uint8_t *tail = _data + Layout::head_size + size_t(value);
+        const size_t tail_size = avail - size_t(value) - 32;
+
+        value = intx::be::unsafe::load<intx::uint256>(tail);
+        check(value <= max_count, "too many elements in dynamic data");
+        check(tail_size >= size_t(value) * Elem::min_size, "not enough data in bridge_message_v0");
+        return abi_array_view<Elem>(tail + 32, size_t(value));
+    }
+
+   private:
+    template <typename>
+    friend class abi_array_view;
+
+    abi_view(const uint8_t *data, size_t size) : _data(data), _size(size) {}
+
+    template <size_t I>
+    const uint8_t *word() const {
+        static_assert(I < Layout::arg_count, "argument index out of range");
+        return _data + Layout::offset(I);
+    }
+
+    static bool is_filled(const uint8_t *p, size_t len, uint8_t value) {
+        uint8_t diff = 0;
+        for (size_t i = 0; i < len; ++i) diff |= p[i] ^ value;
+        return diff == 0;
+    }
+
+    const uint8_t *_data;
+    size_t         _size;
+};
+
+/// Elements of a dynamic array whose total length was validated by abi_view::get_array().
+template <typename Elem>
+class abi_array_view {
+   public:
+    size_t size() const { return _count; }
+
+    abi_view<Elem> operator[](size_t index) const {
+        check(index < _count, "dynamic data index out of range");
+        return abi_view<Elem>(_data + index * Elem::min_size, Elem::min_size);
+    }
+
+   private:
+    template <typename>
+    friend class abi_view;
+
+    abi_array_view(const uint8_t *data, size_t count) : _data(data), _count(count) {}
+
+    const uint8_t *_data;
+    size_t         _count;
+};
+
+// Calls accepted from the EVM side, grouped by the helper contract that sends them.
+namespace calls {
+
+// StakeHelper
+using stake_deposit  = abi_call<0xf45346dc, abi_arg::account, abi_arg::amount, abi_arg::address>;                   // deposit(address,uint256,address)
+using stake_withdraw = abi_call<0x69328dec, abi_arg::account, abi_arg::amount, abi_arg::address>;                   // withdraw(address,uint256,address)
+using stake_restake  = abi_call<0x1d507d2b, abi_arg::account, abi_arg::account, abi_arg::amount, abi_arg::address>; // restake(address,address,uint256,address)
+using stake_claim    = abi_call<0x21c0b342, abi_arg::account, abi_arg::address>;                                    // claim(address,address)
+using stake_claim2   = abi_call<0xfcd42fac, abi_arg::account, abi_arg::address, abi_arg::uint>;                     // claim2(address,address,uint256)
+using stake_transfer = abi_call<0x55b9887d, abi_arg::account, abi_arg::account, abi_arg::amount, abi_arg::address, abi_arg::address>; // transfer(address,address,uint256,address,address)
+using stake_batch    = abi_call<0xd68315a3, abi_arg::address, abi_arg::offset>;                                     // batch(address,(uint8,address,address,uint256)[])
+using stake_batch_op = abi_tuple<abi_arg::uint, abi_arg::account, abi_arg::account, abi_arg::amount>;              // (uint8 kind,address from,address target,uint256 amount)
+
+// RewardHelper
+using reward_claim       = abi_call<0x21c0b342, abi_arg::account, abi_arg::address>;                   // claim(address,address)
+using reward_vdrclaim    = abi_call<0x07b66fc1, abi_arg::account, abi_arg::address>;                   // vdrclaim(address,address)
+using reward_creditclaim = abi_call<0x60b57b3d, abi_arg::account, abi_arg::address, abi_arg::address>; // creditclaim(address,address,address)
+
+// GasFunds
+using gasfunds_claim     = abi_call<0xb4936f13, abi_arg::account, abi_arg::address, abi_arg::uint>; // claim(address,address,uint8)
+using gasfunds_enfclaim  = abi_call<0x33f58043, abi_arg::address>;                                  // enfClaim(address)
+using gasfunds_ramsclaim = abi_call<0x29721a03, abi_arg::address>;                                  // ramsClaim(address)
+
+static_assert(stake_deposit::selector == selector_of("deposit(address,uint256,address)"), "stake_deposit selector mismatch");
+static_assert(stake_withdraw::selector == selector_of("withdraw(address,uint256,address)"), "stake_withdraw selector mismatch");
+static_assert(stake_restake::selector == selector_of("restake(address,address,uint256,address)"), "stake_restake selector mismatch");
+static_assert(stake_claim::selector == selector_of("claim(address,address)"), "stake_claim selector mismatch");
+static_assert(stake_claim2::selector == selector_of("claim2(address,address,uint256)"), "stake_claim2 selector mismatch");
+static_assert(stake_transfer::selector == selector_of("transfer(address,address,uint256,address,address)"), "stake_transfer selector mismatch");
+static_assert(stake_batch::selector == selector_of("batch(address,(uint8,address,address,uint256)[])"), "stake_batch selector mismatch");
+static_assert(reward_claim::selector == selector_of("claim(address,address)"), "reward_claim selector mismatch");
+static_assert(reward_vdrclaim::selector == selector_of("vdrclaim(address,address)"), "reward_vdrclaim selector mismatch");
+static_assert(reward_creditclaim::selector == selector_of("creditclaim(address,address,address)"), "reward_creditclaim selector mismatch");
+static_assert(gasfunds_claim::selector == selector_of("claim(address,address,uint8)"), "gasfunds_claim selector mismatch");
+static_assert(gasfunds_enfclaim::selector == selector_of("enfClaim(address)"), "gasfunds_enfclaim selector mismatch");
+static_assert(gasfunds_ramsclaim::selector == selector_of("ramsClaim(address)"), "gasfunds_ramsclaim selector mismatch");
+
+}  // namespace calls
+
+/// Operation kinds in a StakeHelper batch, matching OP_* in stake_helper.sol.
+enum class stake_op : uint8_t {
+    deposit  = 0,
+    withdraw = 1,
+    restake  = 2,
+    claim    = 3,
+    claim2   = 4
+};
+
+constexpr size_t max_batch_ops = 32;
+
+/// Selectors of calls that only claim, so nothing else in the EVM transaction depends on them running inline.
+/// These are the only calls that may be queued; stake moves always run within the EVM transaction.
+constexpr uint32_t queueable_selectors[] = {
+    calls::stake_claim::selector,  // also RewardHelper claim(address,address)
+    calls::stake_claim2::selector,
+    calls::reward_vdrclaim::selector,
+    calls::reward_creditclaim::selector,
+    calls::gasfunds_claim::selector,
+    calls::gasfunds_enfclaim::selector,
+    calls::gasfunds_ramsclaim::selector,
+};
+
+constexpr bool is_queueable(uint32_t selector) {
+    for (uint32_t s : queueable_selectors) {
+        if (s == selector) return true;
+    }
+    return false;
+}
+
+static_assert(calls::stake_claim::selector == calls::reward_claim::selector, "claim selectors diverged");
+static_assert(!is_queueable(calls::stake_deposit::selector) && !is_queueable(calls::stake_batch::selector), "stake moves must stay atomic");
+
+}  // namespace evmutil
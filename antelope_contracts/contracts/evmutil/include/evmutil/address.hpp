@@ -0,0 +1,63 @@
+#pragma once
+
+#include <array>
+#include <optional>
+#include <evmutil/keccak.hpp>
+
+namespace evmutil {
+
+using evm_address = std::array<uint8_t, 20>;
+
+/// Reserved address standing for an Antelope account: 12 bytes of 0xbb followed by the big-endian name.
+constexpr evm_address make_reserved_address(uint64_t account) {
+    evm_address out = {};
+    for (size_t i = 0; i < 12; ++i) out[i] = 0xbb;
+    for (size_t i = 0; i < 8; ++i) out[19 - i] = uint8_t(account >> (8 * i));
+    return out;
+}
+
+/// Account encoded in a reserved address, or nullopt when `addr` is not one.
+constexpr std::optional<uint64_t> extract_reserved_address(const uint8_t *addr) {
+    uint8_t diff = 0;
+    for (size_t i = 0; i < 12; ++i) diff |= addr[i] ^ 0xbb;
+    if (diff != 0) return std::nullopt;
+
+    uint64_t account = 0;
+    for (size_t i = 12; i < 20; ++i) account = (account << 8) | addr[i];
+    return account;
+}
+
+/// Address of a contract created by `deployer` through CREATE:
+/// the last 20 bytes of keccak256(rlp([deployer, nonce])).
+constexpr evm_address create_address(const evm_address &deployer, uint64_t nonce) {
+    // The list payload is at most 21 + 9 bytes, so both prefixes fit in a single byte.
+    uint8_t buf[1 + 21 + 9] = {};
+    size_t  pos = 1;
+
+    buf[pos++] = 0x80 + 20;
+    for (size_t i = 0; i < 20; ++i) buf[pos++] = deployer[i];
+
+    if (nonce == 0) {
+        buf[pos++] = 0x80;
+    } else if (nonce < 0x80) {
+        buf[pos++] = uint8_t(nonce);
+    } else {
+        size_t len = 0;
+        for (uint64_t v = nonce; v != 0; v >>= 8) ++len;
+        buf[pos++] = uint8_t(0x80 + len);
+        for (size_t i = len; i > 0; --i) buf[pos++] = uint8_t(nonce >> (8 * (i - 1)));
+    }
+    buf[0] = uint8_t(0xc0 + pos - 1);
+
+    const auto hash = keccak256(buf, pos);
+    evm_address out = {};
+    for (size_t i = 0; i < 20; ++i) out[i] = hash[12 + i];
+    return out;
+}
+
+static_assert(make_reserved_address(0x0102030405060708ull)[12] == 0x01 && make_reserved_address(0x0102030405060708ull)[19] == 0x08,
+              "reserved address must hold the big-endian account");
+static_assert(*extract_reserved_address(make_reserved_address(0x0102030405060708ull).data()) == 0x0102030405060708ull,
+              "reserved address round trip");
+
+}  // namespace evmutil
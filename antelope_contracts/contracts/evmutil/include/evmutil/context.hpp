@@ -0,0 +1,43 @@
+#pragma once
+
+#include <optional>
+#include <evmutil/types.hpp>
+#include <evmutil/tables.hpp>
+#include <evmutil/precision.hpp>
+
+namespace evmutil {
+
+/// Per-sender parameters threaded into the stake handlers.
+struct stake_route {
+    precision_scale scale;
+    bool            is_deposit = false;
+    bool            is_xsat = false;
+};
+
+/// State loaded once per action and shared by the handlers and encoders it calls.
+/// Records are written back by evmutil::commit_context() only if marked dirty.
+/// Bridge messages only fill `state`, see evmutil::load_message_context(); admin actions use `config` and `helpers`.
+struct action_context {
+    config_t               config;
+    helpers_t              helpers;
+    state_record           state;
+    std::optional<route_t> sender_route;  // route row matched by the bridge message sender, if any
+    stake_route            route;
+    std::optional<uint64_t> next_nonce;   // next EVM nonce of the contract, once asserted in this action
+    std::vector<simulated_action> *simulated = nullptr;  // collects the inline actions instead of sending them
+
+    bool helpers_loaded = false;
+    bool config_dirty = false;
+    bool helpers_dirty = false;
+
+    void mark_config() { config_dirty = true; }
+    void mark_helpers() { helpers_dirty = true; }
+
+    /// Sends an inline action of a bridge message handler, or records it during simulate().
+    void emit(const eosio::action &act) const {
+        if (simulated) simulated->push_back({act.account, act.name, act.authorization, act.data});
+        else act.send();
+    }
+};
+
+}  // namespace evmutil
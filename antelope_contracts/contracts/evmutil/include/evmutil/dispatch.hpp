@@ -0,0 +1,71 @@
+#pragma once
+
+#include <array>
+#include <evmutil/abi.hpp>
+
+namespace evmutil {
+
+template <typename Handler>
+struct dispatch_entry {
+    uint32_t selector = 0;
+    Handler  handler = nullptr;
+};
+
+/// Binds a handler to the selector of its call layout.
+/// The handler is expected to check the length through an abi_view of the same layout.
+template <typename Call, typename Handler>
+constexpr dispatch_entry<Handler> bind_call(Handler handler) {
+    return {Call::selector, handler};
+}
+
+/// Selector-keyed handler table, sorted at compile time so a lookup is a single binary search.
+template <typename Handler, size_t N>
+class dispatch_table {
+   public:
+    constexpr explicit dispatch_table(const dispatch_entry<Handler> (&entries)[N]) : _entries{} {
+        for (size_t i = 0; i < N; ++i) {
+            size_t j = i;
+            while (j > 0 && _entries[j - 1].selector > entries[i].selector) {
+                _entries[j] = _entries[j - 1];
+                --j;
+            }
+            _entries[j] = entries[i];
+        }
+    }
+
+    constexpr bool unique() const {
+        for (size_t i = 1; i < N; ++i) {
+            if (_entries[i - 1].selector == _entries[i].selector) return false;
+        }
+        return true;
+    }
+
+    constexpr const dispatch_entry<Handler> *find(uint32_t selector) const {
+        size_t lo = 0, hi = N;
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            if (_entries[mid].selector < selector)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        return (lo < N && _entries[lo].selector == selector) ? &_entries[lo] : nullptr;
+    }
+
+    /// Looks up the handler for the selector of the call data.
+    const dispatch_entry<Handler> &route(const byte_span &data) const {
+        const auto *entry = find(read_selector(data));
+        check(entry != nullptr, "unsupported bridge_message version");
+        return *entry;
+    }
+
+   private:
+    std::array<dispatch_entry<Handler>, N> _entries;
+};
+
+template <typename Handler, size_t N>
+constexpr dispatch_table<Handler, N> make_dispatch_table(const dispatch_entry<Handler> (&entries)[N]) {
+    return dispatch_table<Handler, N>(entries);
+}
+
+}  // namespace evmutil
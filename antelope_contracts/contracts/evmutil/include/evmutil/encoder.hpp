@@ -0,0 +1,176 @@
+#pragma once
+
+#include <evmutil/types.hpp>
+#include <evmutil/keccak.hpp>
+
+namespace evmutil {
+
+/// Writes EVM call data into a buffer whose exact size is known up front.
+/// Words are big-endian and left-padded, dynamic `bytes` are length-prefixed and right-padded.
+class abi_encoder {
+   public:
+    abi_encoder(char *out, size_t size) : _out((uint8_t *)out), _size(size) {}
+
+    static constexpr size_t padded(size_t len) { return (len + 31) / 32 * 32; }
+
+    abi_encoder &selector(uint32_t sel) {
+        uint8_t *p = take(4);
+        p[0] = uint8_t(sel >> 24);
+        p[1] = uint8_t(sel >> 16);
+        p[2] = uint8_t(sel >> 8);
+        p[3] = uint8_t(sel);
+        return *this;
+    }
+
+    abi_encoder &word(const intx::uint256 &value) {
+        intx::be::unsafe::store(take(32), value);
+        return *this;
+    }
+
+    abi_encoder &boolean(bool value) {
+        take(32)[31] = value ? 1 : 0;
+        return *this;
+    }
+
+    abi_encoder &address(const uint8_t *addr) {
+        memcpy(take(32) + 32 - kAddressLength, addr, kAddressLength);
+        return *this;
+    }
+
+    abi_encoder &address(const bytes &addr) {
+        check(addr.size() == kAddressLength, "invalid length of address");
+        return address((const uint8_t *)addr.data());
+    }
+
+    /// Unpadded bytes, e.g. contract bytecode ahead of its constructor arguments.
+    abi_encoder &raw(const void *data, size_t len) {
+        memcpy(take(len), data, len);
+        return *this;
+    }
+
+    /// Starts a dynamic `bytes` value of `len` bytes. Its contents are written next, then end_bytes() pads it.
+    size_t begin_bytes(size_t len) {
+        word(len);
+        return _pos;
+    }
+
+    abi_encoder &end_bytes(size_t begin) {
+        take(padded(_pos - begin) - (_pos - begin));
+        return *this;
+    }
+
+    /// Number of bytes written so far, e.g. to locate a nested value for hashing.
+    size_t position() const { return _pos; }
+    const uint8_t *at(size_t pos) const { return _out + pos; }
+
+    /// Checks that exactly the announced number of bytes was written.
+    void finish() const {
+        check(_pos == _size, "abi encoder size mismatch");
+    }
+
+   private:
+    // The buffer is zero-initialized, so skipped padding stays zero.
+    uint8_t *take(size_t len) {
+        check(_size - _pos >= len, "abi encoder overflow");
+        uint8_t *p = _out + _pos;
+        _pos += len;
+        return p;
+    }
+
+    uint8_t *_out;
+    size_t   _size;
+    size_t   _pos = 0;
+};
+
+/// Packed data of an evm_runtime `call` action with zero value, serialized into one exactly-sized buffer.
+/// The call data is written in place through data() before send().
+class evm_call_payload {
+   public:
+    evm_call_payload(eosio::name from, const bytes &to, size_t data_size) : _data_size(data_size) {
+        const size_t value_size = 32;
+        _buf.resize(sizeof(uint64_t) +
+                    pack_size(unsigned_int(to.size())) + to.size() +
+                    pack_size(unsigned_int(value_size)) + value_size +
+                    pack_size(unsigned_int(data_size)) + data_size +
+                    sizeof(uint64_t));
+
+        eosio::datastream<char *> ds(_buf.data(), _buf.size());
+        ds << from;
+        ds << to;
+        ds << unsigned_int(value_size);
+        ds.skip(value_size);
+        ds << unsigned_int(data_size);
+        _data_pos = ds.tellp();
+    }
+
+    abi_encoder data() {
+        return abi_encoder(_buf.data() + _data_pos, _data_size);
+    }
+
+    void send(eosio::name evm_account, const eosio::permission_level &auth, uint64_t gas_limit) {
+        eosio::datastream<char *> ds(_buf.data() + _data_pos + _data_size, sizeof(uint64_t));
+        ds << gas_limit;
+
+        eosio::action act;
+        act.account = evm_account;
+        act.name = "call"_n;
+        act.authorization.push_back(auth);
+        act.data = std::move(_buf);
+        act.send();
+    }
+
+   private:
+    bytes  _buf;
+    size_t _data_pos = 0;
+    size_t _data_size = 0;
+};
+
+// Functions evmutil calls on the contracts it deploys.
+namespace evm_calls {
+
+constexpr uint32_t set_fee = selector_of("setFee(uint256)");
+constexpr uint32_t set_lock_time = selector_of("setLockTime(uint256)");
+constexpr uint32_t upgrade_to_and_call = selector_of("upgradeToAndCall(address,bytes)");
+constexpr uint32_t stake_helper_initialize = selector_of("initialize(address,address,address,uint256,bool,bool)");
+constexpr uint32_t factory_deploy = selector_of("deploy(bytes32,bytes)");
+constexpr uint32_t beacon_upgrade_to = selector_of("upgradeTo(address)");
+constexpr uint32_t collect_fee = selector_of("collectFee(address)");
+
+}  // namespace evm_calls
+
+/// What a CREATE2 deployment is for, stored in the first byte of its salt.
+enum class deploy_tag : uint8_t {
+    stake_impl    = 1,
+    reward_helper = 2,
+    gas_funds     = 3,
+    stake_proxy   = 4,  // followed by the route_kind of the proxy
+    beacon        = 5
+};
+
+/// CREATE2 salt: the tag, an optional sub-tag, and the 20-byte address the deployment belongs to (if any) in the low bytes.
+/// Bytes 4 to 11 are left for the deploy count, see stamp_deploy_count().
+inline std::array<uint8_t, 32> make_deploy_salt(deploy_tag tag, uint8_t sub_tag = 0, const bytes &addr = {}) {
+    std::array<uint8_t, 32> salt = {};
+    salt[0] = uint8_t(tag);
+    salt[1] = sub_tag;
+    if (!addr.empty()) {
+        check(addr.size() == kAddressLength, "invalid length of address");
+        memcpy(salt.data() + 32 - kAddressLength, addr.data(), kAddressLength);
+    }
+    return salt;
+}
+
+/// Writes the big-endian deploy count into bytes 4 to 11 of a salt, so redeploying the same contract for the same
+/// token, e.g. after unregtoken, or the same bytecode again, gets a fresh CREATE2 address.
+inline std::array<uint8_t, 32> stamp_deploy_count(std::array<uint8_t, 32> salt, uint64_t count) {
+    for (size_t i = 0; i < 8; ++i) salt[4 + i] = uint8_t(count >> (8 * (7 - i)));
+    return salt;
+}
+
+/// Key of the deploy count of a salt: the tag and sub-tag folded into route_key() of its address bytes.
+/// Salts sharing a key share a count, which keeps their addresses apart all the same.
+inline uint64_t deploy_count_key(const std::array<uint8_t, 32> &salt) {
+    return route_key(salt.data() + 32 - kAddressLength) ^ (uint64_t(salt[0]) << 56) ^ (uint64_t(salt[1]) << 48);
+}
+
+}  // namespace evmutil
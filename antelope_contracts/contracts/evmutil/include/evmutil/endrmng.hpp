@@ -124,6 +124,23 @@ namespace endrmng {
         void evmclaim2(const name& caller, const checksum160& proxy, const checksum160& staker, const name& validator,
                    const uint16_t donate_rate);
 
+        /**
+        * Evm transfer stake action, moves stake from one staker to another.
+        * @auth scope is `evmcaller` whitelist account
+        *
+        * @param caller - the account that calls the method
+        * @param proxy - proxy address
+        * @param from_staker - staker address the stake is taken from
+        * @param to_staker - staker address the stake is given to
+        * @param old_validator - validator the stake is taken from
+        * @param new_validator - validator the stake is given to
+        * @param quantity - transferred amount of pledge
+        *
+        */
+        [[eosio::action]]
+        void evmtransfer(const name& caller, const checksum160& proxy, const checksum160& from_staker, const checksum160& to_staker,
+                        const name& old_validator, const name& new_validator, const asset& quantity);
+
     };
 
     using evmstake_action = action_wrapper<"evmstake"_n, &contract_actions::evmstake>;
@@ -136,4 +153,5 @@ namespace endrmng {
     using evmunstkxsat_action = action_wrapper<"evmunstkxsat"_n, &contract_actions::evmunstkxsat>;
 
     using evmclaim2_action = action_wrapper<"evmclaim2"_n, &contract_actions::evmclaim2>;
+    using evmtransfer_action = action_wrapper<"evmtransfer"_n, &contract_actions::evmtransfer>;
 }
@@ -5,6 +5,9 @@
 #include <eosio/singleton.hpp>
 #include <evmutil/types.hpp>
 #include <evmutil/tables.hpp>
+#include <evmutil/context.hpp>
+#include <evmutil/dispatch.hpp>
+#include <evmutil/encoder.hpp>
 #include <intx/intx.hpp>
 
 
@@ -41,6 +44,14 @@ class [[eosio::contract]] evmutil : public contract {
      */
     [[eosio::action]] void onbridgemsg(const bridge_message_t &message);
 
+    /**
+     * @brief Processes a bridge message whose byte fields are spans over the action data.
+     *        Entry point for onbridgemsg from pre_dispatch(), which skips deserializing into vectors.
+     * 
+     * @param msg 
+     */
+    void handle_bridge_message(const bridge_message_view &msg);
+
     /**
      * @brief Deploy the implementation contract for stake helper in EVM. 
      *        Only works with certain leap configs. 
@@ -51,6 +62,26 @@ class [[eosio::contract]] evmutil : public contract {
      */
     [[eosio::action]] void dpystakeimpl();
 
+    /**
+     * @brief Set up a fresh contract in one transaction: init(), then deploy the stake helper implementation,
+     *        the reward helper, the gas funds, the validator deposit helpers and the stake helpers of `tokens`.
+     *        The EVM nonce is asserted once for all deployments, and config and helpers are written once.
+     *        The bytecodes must be uploaded and the account opened in the EVM contract beforehand.
+     * 
+     * @auth Self
+     * 
+     * @param evm_account - The account of the EVM contract.
+     * @param gas_token_symbol - The symbol of the gas token. Should be same for both EVM and exSat.
+     * @param gaslimit - The gas limit used when the contract calls EVM functions.
+     * @param init_gaslimit - The gas limit used when the contract deploys EVM contracts.
+     * @param btc_deposit - Token of the BTC validator deposit helper, if it should be deployed.
+     * @param xsat_deposit - Token of the XSAT validator deposit helper, if it should be deployed.
+     * @param tokens - The tokens to register.
+     */
+    [[eosio::action]] void bootstrap(eosio::name evm_account, eosio::symbol gas_token_symbol, uint64_t gaslimit, uint64_t init_gaslimit,
+                                     const std::optional<token_spec> &btc_deposit, const std::optional<token_spec> &xsat_deposit,
+                                     const std::vector<token_spec> &tokens);
+
     /**
      * @brief Set the default implementation for stake helper.
      * 
@@ -106,6 +137,17 @@ class [[eosio::contract]] evmutil : public contract {
      */
     [[eosio::action]] void regwithcode(std::string token_address, std::string impl_address, const eosio::asset &dep_fee, uint8_t erc20_precision);
 
+    /**
+     * @brief Register several ERC20 tokens that wrap BTC in one transaction.
+     *        Deploy a stake helper via proxy for each of them, using the default implementation.
+     *        The EVM nonce is asserted once and tracked locally across the batch.
+     * 
+     * @auth Self
+     * 
+     * @param tokens - The tokens to register, each with its address, deposit fee and ERC20 precision.
+     */
+    [[eosio::action]] void regtokens(const std::vector<token_spec> &tokens);
+
     /**
      * @brief Unregister an token.
      * 
@@ -159,6 +201,7 @@ class [[eosio::contract]] evmutil : public contract {
     
     /**
      * @brief Update the implementation of target stake helper to latest.
+     *        Beacon proxies are rejected, setbeaconimpl upgrades them all through the beacon.
      * 
      * @auth Self
      * 
@@ -166,6 +209,36 @@ class [[eosio::contract]] evmutil : public contract {
      */
     [[eosio::action]] void upstakeimpl(std::string proxy_address);
 
+    /**
+     * @brief Start a job that applies an admin operation to every stake helper proxy, in chunks run by runfleet().
+     *        Proxies are visited in order: the BTC and XSAT deposit helpers, then the registered tokens by id.
+     * 
+     * @auth Self
+     * 
+     * @param op - setdepfee (registered tokens only), setlocktime, upstakeimpl (to the latest implementation, skipping beacon proxies) or collectfee.
+     * @param fee - New deposit fee, for setdepfee.
+     * @param locktime - New lock time in EVM blocks, for setlocktime.
+     * @param dest - 0x EVM address receiving the collected fees, for collectfee.
+     */
+    [[eosio::action]] void startfleet(eosio::name op, std::optional<eosio::asset> fee, std::optional<uint64_t> locktime, std::optional<std::string> dest);
+
+    /**
+     * @brief Run the next chunk of the fleet job and store the cursor. The job is removed once every proxy was visited.
+     * 
+     * @auth Self
+     * 
+     * @param max_proxies - The maximum number of proxies to visit in this chunk, skipped ones included.
+     */
+    [[eosio::action]] void runfleet(uint32_t max_proxies);
+
+    /**
+     * @brief Cancel the running fleet job. Proxies already called keep their new settings.
+     * 
+     * @auth Self
+     * 
+     */
+    [[eosio::action]] void cancelfleet();
+
     /**
      * @brief Deploy the contract for validator deposits in EVM for BTC staking. 
      * 
@@ -203,6 +276,266 @@ class [[eosio::contract]] evmutil : public contract {
 
     [[eosio::action]] void initgasfund();
 
+    /**
+     * @brief Deploy the CREATE2 deploy factory in EVM and switch deployments to it.
+     *        Contracts deployed afterwards get addresses derived from a salt instead of the nonce.
+     * 
+     * @auth Self
+     * 
+     */
+    [[eosio::action]] void dpyfactory();
+
+    /**
+     * @brief Set the address of the CREATE2 deploy factory.
+     * 
+     * @auth Self
+     * 
+     * @param factory_address - The factory address. An empty string switches back to nonce based deployment.
+     */
+    [[eosio::action]] void setfactory(std::string factory_address);
+
+    /**
+     * @brief Select the proxy contract used for stake helpers deployed from now on.
+     *        Proxies already deployed are not affected.
+     * 
+     * @auth Self
+     * 
+     * @param mode - 0 for the full ERC1967 proxy, 1 for the minimal proxy, 2 for the beacon proxy.
+     */
+    [[eosio::action]] void setproxymode(uint8_t mode);
+
+    /**
+     * @brief Deploy the stake helper beacon in EVM, pointing at the latest implementation.
+     *        Stake helpers deployed in beacon proxy mode resolve their implementation through it.
+     * 
+     * @auth Self
+     * 
+     */
+    [[eosio::action]] void dpybeacon();
+
+    /**
+     * @brief Upgrade every beacon proxy stake helper to the latest implementation with a single EVM call to the beacon.
+     * 
+     * @auth Self
+     * 
+     */
+    [[eosio::action]] void setbeaconimpl();
+
+    /**
+     * @brief Upload the next chunk of an EVM contract bytecode to the bytecode store.
+     *        Chunks must be uploaded in order, starting at 0, before the version is finalized.
+     * 
+     * @auth Self
+     * 
+     * @param kind - The contract kind: stakehelper, rwdhelper, gasfunds, proxy, minproxy, dpyfactory, beacon or beaconproxy.
+     * @param version - The bytecode version.
+     * @param chunk_index - The index of this chunk.
+     * @param data - The chunk content.
+     */
+    [[eosio::action]] void uploadcode(eosio::name kind, uint32_t version, uint32_t chunk_index, const bytes &data);
+
+    /**
+     * @brief Check the sha256 of an uploaded bytecode and make it available to the deploy actions.
+     *        Deployments use the finalized version with the highest number.
+     * 
+     * @auth Self
+     * 
+     * @param kind - The contract kind.
+     * @param version - The bytecode version.
+     * @param hash - The expected sha256 of the whole bytecode.
+     */
+    [[eosio::action]] void finalizecode(eosio::name kind, uint32_t version, const checksum256 &hash);
+
+    /**
+     * @brief Remove a bytecode version and its chunks from the bytecode store.
+     * 
+     * @auth Self
+     * 
+     * @param kind - The contract kind.
+     * @param version - The bytecode version.
+     */
+    [[eosio::action]] void rmcode(eosio::name kind, uint32_t version);
+
+    /**
+     * @brief Rebuild the sender route table from the helpers and registered tokens.
+     *        Needed after upgrading a contract that had no legacy tokens, migtokens writes the routes otherwise.
+     *        Until routes exist bridge messages are routed through the helpers and token tables directly.
+     *        Deposit helpers without a route get the legacy 18-decimal precision.
+     * 
+     * @auth Self
+     * 
+     */
+    [[eosio::action]] void syncroutes();
+
+    /**
+     * @brief Move registered tokens from the legacy "tokens" table to the compact "tokens2" table, keeping their ids,
+     *        and write the route of each moved token. Token registration and fleet jobs are blocked until every row has been moved.
+     *        The call moving the last row also writes the helper routes, after which bridge messages only use routes.
+     * 
+     * @auth Self
+     * 
+     * @param max_rows - The maximum number of rows to move in this action.
+     */
+    [[eosio::action]] void migtokens(uint32_t max_rows);
+
+    /**
+     * @brief Move the config and helpers singletons into the fixed-size state record and erase them.
+     *        Required once after upgrading from a version without the record; until then the singletons stay in use.
+     * 
+     * @auth Self
+     * 
+     */
+    [[eosio::action]] void migconfig();
+
+    /**
+     * @brief Decode the config and helpers, from the state record or the singletons before migconfig().
+     *        Read-only, so it can be run without a signed transaction.
+     * 
+     * @return The config and the helper addresses, 0x hex.
+     */
+    [[eosio::action, eosio::read_only]] config_info getconfig();
+
+    /**
+     * @brief Make a registered implementation the current one, e.g. to roll back an upgrade.
+     * 
+     * @auth Self
+     * 
+     * @param id - The id of the implcontract row.
+     */
+    [[eosio::action]] void setcurimpl(uint64_t id);
+
+    /**
+     * @brief Recount the proxies and beacon running each implementation, walking the routes in chunks.
+     *        Gives rows registered before references were counted a proxy_count, so pruneimpl() can erase them.
+     *        Registering, upgrading and unregistering proxies is blocked until the walk is done.
+     * 
+     * @auth Self
+     * 
+     * @param legacy_impl_id - The implcontract row run by proxies registered before references were counted,
+     *                         normally the current one after a fleet upgrade. Only read by the first call of a recount.
+     * @param max_rows - The maximum number of routes to examine in this action.
+     */
+    [[eosio::action]] void recountimpl(uint64_t legacy_impl_id, uint32_t max_rows);
+
+    /**
+     * @brief Erase superseded implementation rows that no proxy or beacon runs anymore.
+     *        Rows registered before references were counted are kept until recountimpl() ran.
+     * 
+     * @auth Self
+     * 
+     * @param from_id - The first implcontract row to examine.
+     * @param max_rows - The maximum number of rows to examine in this action.
+     */
+    [[eosio::action]] void pruneimpl(uint64_t from_id, uint32_t max_rows);
+
+    /**
+     * @brief Report row counts and serialized sizes of the contract tables, including the bytecode store.
+     *        Read-only, so it can be run without a signed transaction.
+     * 
+     * @param max_rows - The maximum number of rows to scan per table scope.
+     * @return The statistics of every table scope.
+     */
+    [[eosio::action, eosio::read_only]] std::vector<table_stats> getstats(uint32_t max_rows);
+
+    /**
+     * @brief List every EVM contract allowed to send bridge messages: stake helper proxies of registered tokens,
+     *        validator deposit helpers, the reward helper and the gas funds, with decoded addresses.
+     *        Read-only, so it can be run without a signed transaction.
+     * 
+     * @param lower_key - The route key to start from, 0 or the next_key of the previous page.
+     * @param limit - The maximum number of routes to return, at most 100.
+     * @return The page of routes in route key order.
+     */
+    [[eosio::action, eosio::read_only]] route_page getroutes(uint64_t lower_key, uint32_t limit);
+
+    /**
+     * @brief Dry-run a bridge message through the same routing and decoding as onbridgemsg.
+     *        Read-only, so relayers can pre-validate messages without a signed transaction.
+     *        A message onbridgemsg would reject fails here with the same assertion message.
+     * 
+     * @param message - The bridge message, as the EVM contract would deliver it.
+     * @return The inline actions onbridgemsg would send, with their authorization and packed data.
+     *         The data is not decoded here; decode it with the ABI of the receiving contract.
+     */
+    [[eosio::action, eosio::read_only]] std::vector<simulated_action> simulate(const bridge_message_t &message);
+
+    /**
+     * @brief Queue or un-queue bridge messages with a given selector from one kind of route. Queued messages are
+     *        validated by onbridgemsg and stored, then dispatched by process(). Only claim calls can be queued,
+     *        stake moves stay atomic.
+     * 
+     * @auth Self
+     * 
+     * @param kind - The route kind of the senders: 0 rewards, 1 btc deposit, 2 xsat deposit, 3 gas funds, 4 erc20 stake.
+     * @param selector - The 4-byte function selector of the call.
+     * @param queued - Whether messages with this selector from this kind of route are queued.
+     */
+    [[eosio::action]] void setqueued(uint8_t kind, uint32_t selector, bool queued);
+
+    /**
+     * @brief Cap the message queue. Once the ids between the oldest queued message and the next one span
+     *        `max_length`, further messages are dispatched inline as if they were not queued.
+     *        The cap starts at 1000 whenever the first call is queued.
+     * 
+     * @auth Self
+     * 
+     * @param max_length - The maximum span of queued message ids.
+     */
+    [[eosio::action]] void setqueuecap(uint32_t max_length);
+
+    /**
+     * @brief Dispatch queued bridge messages in arrival order, each removed once its inline actions were sent.
+     *        A message whose inline action fails reverts the whole batch; start after it to keep the rest moving.
+     * 
+     * @auth None, anyone may run the queue.
+     * 
+     * @param start_id - The id of the first message to dispatch, 0 for the head of the queue.
+     * @param max - The maximum number of messages to dispatch, at most 50.
+     */
+    [[eosio::action]] void process(uint64_t start_id, uint32_t max);
+
+    /**
+     * @brief Drop a queued bridge message that can no longer be dispatched, so batches from the head of the queue stop failing.
+     * 
+     * @auth Self
+     * 
+     * @param id - The id of the queued message.
+     */
+    [[eosio::action]] void dropqueued(uint64_t id);
+
+    /**
+     * @brief Coalesce claims from one kind of route. Once a claim was sent in a block, an exact duplicate later
+     *        in the same block (same kind, proxy, staker, validator and donate rate) is skipped without sending
+     *        anything, even if the claimed contract changed state in between. Off by default, so claims of other
+     *        routes neither hash nor touch the claim log.
+     * 
+     * @auth Self
+     * 
+     * @param kind - The route kind of the senders: 0 rewards, 1 btc deposit, 2 xsat deposit, 3 gas funds, 4 erc20 stake.
+     * @param enabled - Whether claims from this kind of route are coalesced.
+     */
+    [[eosio::action]] void setcoalesce(uint8_t kind, bool enabled);
+
+    /**
+     * @brief Choose how StakeHelper transfers reach endrmng. Off by default, each transfer is sent as an
+     *        evmunstake from the user followed by an evmstake for the operator. Turn it on once endrmng
+     *        provides evmtransfer, to move the stake in one action.
+     * 
+     * @auth Self
+     * 
+     * @param single_transfer - Whether transfers are sent as one endrmng evmtransfer.
+     */
+    [[eosio::action]] void setstaketrf(bool single_transfer);
+
+    /**
+     * @brief Erase claim log rows from earlier blocks. They no longer skip anything and only hold RAM.
+     * 
+     * @auth None, anyone may prune.
+     * 
+     * @param max_rows - The maximum number of rows to examine in this action.
+     */
+    [[eosio::action]] void pruneclaims(uint32_t max_rows);
+
 
 
     // Public Helpers
@@ -212,19 +545,110 @@ class [[eosio::contract]] evmutil : public contract {
     helpers_t get_helpers() const;
     void set_helpers(const helpers_t &v);
 
+    action_context load_context(bool with_helpers = true) const;
+    action_context load_message_context() const;
+    void commit_context(const action_context &ctx);
+
+    bool read_state(state_record &state) const;
+    void write_state(const state_record &state);
+    void store_state(const config_t *config, const helpers_t *helpers);
+    state_record current_state() const;
+    bool config_initialized() const;
+
     intx::uint256 get_minimum_natively_representable(const config_t& config) const;
-    uint64_t get_next_nonce();
+    uint64_t get_next_nonce(const config_t &config);
 
 private:
 
     // Private Helpers
-    void regtokenwithcodebytes(const bytes& erc20_address_bytes, const bytes& impl_address_bytes, const eosio::asset& dep_fee, uint8_t erc20_precision);
-    bytes deploy_stake_helper_proxy(const bytes& erc20_address_bytes, const bytes& impl_address_bytes, const eosio::asset& dep_fee, uint8_t erc20_precision, bool notBTC, bool isValidatorDeposits);
-
-    void handle_endorser_stakes(const bridge_message_v0 &msg, uint64_t delta_precision, bool is_deposit, bool is_xsat);
-    void handle_utxo_access(const bridge_message_v0 &msg);
-    void handle_rewards(const bridge_message_v0 &msg);
-    void handle_gasfunds(const bridge_message_v0& msg);
+    void regtokenwithcodebytes(action_context &ctx, const bytes& erc20_address_bytes, const bytes& impl_address_bytes, std::optional<uint64_t> impl_id, const eosio::asset& dep_fee, uint8_t erc20_precision);
+    bytes deploy_stake_helper_proxy(action_context &ctx, route_kind kind, const bytes& erc20_address_bytes, const bytes& impl_address_bytes, const eosio::asset& dep_fee, uint8_t erc20_precision);
+
+    // Routes a bridge message to its handler. Shared by onbridgemsg, simulate() and process().
+    void dispatch_bridge_message(action_context &ctx, const bridge_message_view &msg);
+    bool enqueue_bridge_message(action_context &ctx, const bridge_message_view &msg);
+
+    void check_tokens_migrated() const;
+    bool first_claim_in_block(const action_context &ctx, claim_kind kind, const checksum160 &proxy, const checksum160 &staker, uint64_t target, uint16_t variant = 0);
+    table_stats scan_table(eosio::name table, eosio::name scope, uint32_t max_rows) const;
+
+    // Implementation registry. References are counted per implcontract row so superseded rows can be pruned.
+    impl_contract_t current_impl() const;
+    uint64_t add_impl(const bytes &address);
+    void move_impl_ref(std::optional<uint64_t> from, std::optional<uint64_t> to);
+    void set_proxy_impl(const bytes &proxy, std::optional<uint64_t> impl_id, std::optional<proxy_mode> mode = std::nullopt);
+
+    // Deployments shared by the dpy* actions and bootstrap(). They update the context and leave committing it to the caller.
+    bytes deploy_stake_impl(action_context &ctx);
+    void deploy_reward_helper(action_context &ctx);
+    void deploy_gas_funds(action_context &ctx);
+    void deploy_deposit_helper(action_context &ctx, route_kind kind, const token_spec &token);
+    void register_tokens(action_context &ctx, const std::vector<token_spec> &tokens);
+
+    // Deploys `code_size` bytes of init code written by `write_code(abi_encoder&)` and returns the new contract address.
+    // Goes through the CREATE2 factory when one is set, otherwise deploys directly and derives the address from the nonce,
+    // which is asserted once per action and then tracked in the context.
+    // Latest finalized bytecode of `kind` in the bytecode store, and a writer streaming its chunks as init code.
+    bytecode_t find_code(eosio::name kind) const;
+    void write_code(abi_encoder &out, eosio::name kind, const bytecode_t &code) const;
+
+    template <typename WriteCode>
+    bytes deploy_contract(action_context &ctx, size_t code_size, const std::array<uint8_t, 32> &salt, WriteCode write_code);
+
+    void set_route(const bytes &sender, route_kind kind, uint8_t delta_precision);
+    void erase_route(const bytes &sender);
+    route_table_t::const_iterator find_route(const route_table_t &routes, const byte_span &sender) const;
+    std::optional<route_t> find_legacy_route(const state_record &state, const byte_span &sender) const;
+    std::optional<route_t> find_proxy_route(const bytes &proxy) const;
+    void sync_helper_routes(const config_t &config);
+    uint8_t legacy_deposit_delta(eosio::symbol gas_token) const;
+    uint8_t get_delta_precision(const config_t &config, uint8_t erc20_precision) const;
+    uint8_t get_delta_precision(eosio::symbol gas_token, uint8_t erc20_precision) const;
+
+    void handle_endorser_stakes(action_context &ctx, const bridge_message_view &msg);
+    void handle_utxo_access(const bridge_message_view &msg);
+    void handle_rewards(action_context &ctx, const bridge_message_view &msg);
+    void handle_gasfunds(action_context &ctx, const bridge_message_view &msg);
+
+    // Per-selector handlers, routed through the dispatch tables in handle_endorser_stakes/handle_rewards/handle_gasfunds.
+    // Each receives a view of the call data already checked against its layout.
+    using message_handler_t = void (evmutil::*)(action_context &ctx, const bridge_message_view &msg);
+
+    template <typename Call, void (evmutil::*Handler)(action_context &, const bridge_message_view &, const abi_view<Call> &)>
+    void decode_and_handle(action_context &ctx, const bridge_message_view &msg) {
+        (this->*Handler)(ctx, msg, abi_view<Call>(msg.data));
+    }
+
+    template <typename Call, void (evmutil::*Handler)(action_context &, const bridge_message_view &, const abi_view<Call> &)>
+    static constexpr dispatch_entry<message_handler_t> bind_view() {
+        return bind_call<Call>(&evmutil::decode_and_handle<Call, Handler>);
+    }
+
+    void handle_stake_claim(action_context &ctx, const bridge_message_view &msg, const abi_view<calls::stake_claim> &args);
+    void handle_stake_claim2(action_context &ctx, const bridge_message_view &msg, const abi_view<calls::stake_claim2> &args);
+    void handle_stake_deposit(action_context &ctx, const bridge_message_view &msg, const abi_view<calls::stake_deposit> &args);
+    void handle_stake_withdraw(action_context &ctx, const bridge_message_view &msg, const abi_view<calls::stake_withdraw> &args);
+    void handle_stake_restake(action_context &ctx, const bridge_message_view &msg, const abi_view<calls::stake_restake> &args);
+    void handle_stake_transfer(action_context &ctx, const bridge_message_view &msg, const abi_view<calls::stake_transfer> &args);
+    void handle_stake_batch(action_context &ctx, const bridge_message_view &msg, const abi_view<calls::stake_batch> &args);
+
+    void handle_reward_claim(action_context &ctx, const bridge_message_view &msg, const abi_view<calls::reward_claim> &args);
+    void handle_reward_vdrclaim(action_context &ctx, const bridge_message_view &msg, const abi_view<calls::reward_vdrclaim> &args);
+    void handle_reward_creditclaim(action_context &ctx, const bridge_message_view &msg, const abi_view<calls::reward_creditclaim> &args);
+
+    void handle_gasfunds_claim(action_context &ctx, const bridge_message_view &msg, const abi_view<calls::gasfunds_claim> &args);
+    void handle_gasfunds_enfclaim(action_context &ctx, const bridge_message_view &msg, const abi_view<calls::gasfunds_enfclaim> &args);
+    void handle_gasfunds_ramsclaim(action_context &ctx, const bridge_message_view &msg, const abi_view<calls::gasfunds_ramsclaim> &args);
+
+    // Sends the call of a fleet job to one proxy.
+    void send_fleet_call(const action_context &ctx, const fleet_job_t &job, const bytes &proxy);
+
+    // Inline endrmng actions shared by the single-operation and batch stake handlers.
+    void send_stake(const action_context &ctx, const checksum160 &proxy, const checksum160 &staker, uint64_t validator, uint64_t amount);
+    void send_unstake(const action_context &ctx, const checksum160 &proxy, const checksum160 &staker, uint64_t validator, uint64_t amount);
+    void send_restake(const action_context &ctx, const checksum160 &proxy, const checksum160 &staker, uint64_t from_validator, uint64_t to_validator, uint64_t amount);
+    void send_claim(const action_context &ctx, const checksum160 &proxy, const checksum160 &staker, uint64_t validator);
+    void send_claim2(const action_context &ctx, const checksum160 &proxy, const checksum160 &staker, uint64_t validator, uint16_t donate_rate);
 
     eosio::name receiver_account()const;
 };
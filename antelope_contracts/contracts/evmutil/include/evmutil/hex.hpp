@@ -64,4 +64,22 @@ inline std::optional<bytes> from_hex(std::string_view hex) {
     return bs;
 }
 
+/// Encodes bytes as lowercase hex with a 0x prefix.
+inline std::string to_hex(const uint8_t *data, size_t size) {
+    static constexpr char digits[] = "0123456789abcdef";
+    std::string out(2 + 2 * size, '\0');
+    out[0] = '0';
+    out[1] = 'x';
+    for (size_t i = 0; i < size; ++i) {
+        out[2 + 2 * i] = digits[data[i] >> 4];
+        out[3 + 2 * i] = digits[data[i] & 0x0f];
+    }
+    return out;
+}
+
+inline std::string to_hex(const checksum160 &addr) {
+    const auto raw = addr.extract_as_byte_array();
+    return to_hex(raw.data(), raw.size());
+}
+
 }  // namespace evmutil
\ No newline at end of file
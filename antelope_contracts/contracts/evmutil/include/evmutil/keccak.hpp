@@ -0,0 +1,117 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace evmutil {
+
+namespace detail {
+
+constexpr uint64_t keccak_round_constants[24] = {
+    0x0000000000000001ull, 0x0000000000008082ull, 0x800000000000808aull, 0x8000000080008000ull,
+    0x000000000000808bull, 0x0000000080000001ull, 0x8000000080008081ull, 0x8000000000008009ull,
+    0x000000000000008aull, 0x0000000000000088ull, 0x0000000080008009ull, 0x000000008000000aull,
+    0x000000008000808bull, 0x800000000000008bull, 0x8000000000008089ull, 0x8000000000008003ull,
+    0x8000000000008002ull, 0x8000000000000080ull, 0x000000000000800aull, 0x800000008000000aull,
+    0x8000000080008081ull, 0x8000000000008080ull, 0x0000000080000001ull, 0x8000000080008008ull,
+};
+
+// Rotation offsets of lane (x, y), stored at x + 5 * y.
+constexpr unsigned keccak_rotations[25] = {
+     0,  1, 62, 28, 27,
+    36, 44,  6, 55, 20,
+     3, 10, 43, 25, 39,
+    41, 45, 15, 21,  8,
+    18,  2, 61, 56, 14,
+};
+
+constexpr uint64_t rotl64(uint64_t x, unsigned n) {
+    return n == 0 ? x : (x << n) | (x >> (64 - n));
+}
+
+constexpr void keccak_f1600(uint64_t (&a)[25]) {
+    for (size_t round = 0; round < 24; ++round) {
+        uint64_t c[5] = {};
+        for (size_t x = 0; x < 5; ++x) c[x] = a[x] ^ a[x + 5] ^ a[x + 10] ^ a[x + 15] ^ a[x + 20];
+        for (size_t x = 0; x < 5; ++x) {
+            uint64_t d = c[(x + 4) % 5] ^ rotl64(c[(x + 1) % 5], 1);
+            for (size_t y = 0; y < 25; y += 5) a[x + y] ^= d;
+        }
+
+        uint64_t b[25] = {};
+        for (size_t x = 0; x < 5; ++x) {
+            for (size_t y = 0; y < 5; ++y) {
+                b[y + 5 * ((2 * x + 3 * y) % 5)] = rotl64(a[x + 5 * y], keccak_rotations[x + 5 * y]);
+            }
+        }
+
+        for (size_t y = 0; y < 25; y += 5) {
+            for (size_t x = 0; x < 5; ++x) {
+                a[x + y] = b[x + y] ^ (~b[(x + 1) % 5 + y] & b[(x + 2) % 5 + y]);
+            }
+        }
+        a[0] ^= keccak_round_constants[round];
+    }
+}
+
+}  // namespace detail
+
+/// Keccak-256 with the original 0x01 padding, as used by the EVM. Usable in constant expressions.
+constexpr std::array<uint8_t, 32> keccak256(const uint8_t *data, size_t len) {
+    constexpr size_t rate = 136;
+    uint64_t state[25] = {};
+
+    size_t pos = 0;
+    for (;;) {
+        uint8_t block[rate] = {};
+        const size_t take = len - pos < rate ? len - pos : rate;
+        for (size_t i = 0; i < take; ++i) block[i] = data[pos + i];
+        pos += take;
+
+        const bool last = take < rate;
+        if (last) {
+            block[take] ^= 0x01;
+            block[rate - 1] ^= 0x80;
+        }
+
+        for (size_t lane = 0; lane < rate / 8; ++lane) {
+            uint64_t v = 0;
+            for (size_t i = 0; i < 8; ++i) v |= uint64_t(block[lane * 8 + i]) << (8 * i);
+            state[lane] ^= v;
+        }
+        detail::keccak_f1600(state);
+
+        if (last) break;
+    }
+
+    std::array<uint8_t, 32> out = {};
+    for (size_t i = 0; i < 32; ++i) out[i] = uint8_t(state[i / 8] >> (8 * (i % 8)));
+    return out;
+}
+
+/// EVM function selector: the first four bytes of keccak256(signature), read big-endian.
+template <size_t N>
+constexpr uint32_t selector_of(const char (&signature)[N]) {
+    uint8_t text[N] = {};
+    for (size_t i = 0; i + 1 < N; ++i) text[i] = uint8_t(signature[i]);
+    const auto hash = keccak256(text, N - 1);
+    return (uint32_t(hash[0]) << 24) | (uint32_t(hash[1]) << 16) | (uint32_t(hash[2]) << 8) | uint32_t(hash[3]);
+}
+
+/// Address of a contract created by `deployer` through CREATE2:
+/// the last 20 bytes of keccak256(0xff ++ deployer ++ salt ++ keccak256(init_code)).
+constexpr std::array<uint8_t, 20> create2_address(const uint8_t *deployer, const std::array<uint8_t, 32> &salt,
+                                                  const std::array<uint8_t, 32> &code_hash) {
+    uint8_t buf[1 + 20 + 32 + 32] = {0xff};
+    for (size_t i = 0; i < 20; ++i) buf[1 + i] = deployer[i];
+    for (size_t i = 0; i < 32; ++i) buf[21 + i] = salt[i];
+    for (size_t i = 0; i < 32; ++i) buf[53 + i] = code_hash[i];
+
+    const auto hash = keccak256(buf, sizeof(buf));
+    std::array<uint8_t, 20> out = {};
+    for (size_t i = 0; i < 20; ++i) out[i] = hash[12 + i];
+    return out;
+}
+
+}  // namespace evmutil
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <limits>
+#include <evmutil/types.hpp>
+
+namespace evmutil {
+
+/// 10^n for every n whose power fits in 64 bits.
+constexpr uint64_t pow10_u64[] = {
+    1ull,
+    10ull,
+    100ull,
+    1000ull,
+    10000ull,
+    100000ull,
+    1000000ull,
+    10000000ull,
+    100000000ull,
+    1000000000ull,
+    10000000000ull,
+    100000000000ull,
+    1000000000000ull,
+    10000000000000ull,
+    100000000000000ull,
+    1000000000000000ull,
+    10000000000000000ull,
+    100000000000000000ull,
+    1000000000000000000ull,
+    10000000000000000000ull,
+};
+constexpr uint8_t max_pow10_u64 = sizeof(pow10_u64) / sizeof(pow10_u64[0]) - 1;
+
+/// 10^exp as uint256, built from the table instead of a general exponentiation.
+inline intx::uint256 pow10_u256(uint8_t exp) {
+    check(exp <= 77, "power of ten out of range");
+    intx::uint256 result = pow10_u64[exp % max_pow10_u64];
+    for (uint8_t i = 0; i < exp / max_pow10_u64; ++i) result *= pow10_u64[max_pow10_u64];
+    return result;
+}
+
+/// Scale between an EVM-side amount and its native amount, which has `delta` fewer decimals.
+struct precision_scale {
+    uint8_t  delta = 0;
+    uint64_t multiplier = 1;  // 10^delta when it fits in 64 bits, 0 otherwise
+
+    static constexpr precision_scale of(uint8_t delta) {
+        return {delta, delta <= max_pow10_u64 ? pow10_u64[delta] : 0};
+    }
+};
+
+/// Scale between native token amounts and the 18-decimal EVM gas token.
+constexpr precision_scale gas_token_scale(const eosio::symbol &native_symbol) {
+    return precision_scale::of(evm_precision - native_symbol.precision());
+}
+
+/// Converts an EVM-side amount to a native amount. Rejects dust, zero, and values outside the native range.
+inline uint64_t to_native_amount(const intx::uint256 &value, const precision_scale &scale) {
+    constexpr uint64_t max_native_amount = (1ull << 62) - 1;
+    uint64_t output = 0;
+
+    if (scale.multiplier != 0 && value <= std::numeric_limits<uint64_t>::max()) {
+        // Amounts below 2^64 (e.g. under ~18.4 tokens at 18 decimals) stay in native 64-bit arithmetic.
+        const uint64_t v = static_cast<uint64_t>(value);
+        check(v % scale.multiplier == 0, "bridge amount can not have dust");
+        output = v / scale.multiplier;
+    }
+    else if (scale.multiplier != 0) {
+        // A result that fits 62 bits times a 64-bit multiplier always fits 128 bits.
+        // Wider values overflow, but are checked for dust first like on every other path.
+        if ((value >> 128) != 0_u256) {
+            check(value % intx::uint256(scale.multiplier) == 0_u256, "bridge amount can not have dust");
+            check(false, "bridge amount value overflow");
+        }
+        const intx::uint128 v = static_cast<intx::uint128>(value);
+        check(v % scale.multiplier == 0, "bridge amount can not have dust");
+        const intx::uint128 scaled = v / scale.multiplier;
+        check(scaled <= max_native_amount, "bridge amount value overflow");
+        output = static_cast<uint64_t>(scaled);
+    }
+    else {
+        const intx::uint256 mult = pow10_u256(scale.delta);
+        check(value % mult == 0_u256, "bridge amount can not have dust");
+        const intx::uint256 scaled = value / mult;
+        check(scaled <= max_native_amount, "bridge amount value overflow");
+        output = static_cast<uint64_t>(scaled);
+    }
+
+    check(output < max_native_amount, "bridge amount value overflow");
+    check(output > 0, "bridge amount must be positive");
+    return output;
+}
+
+/// Converts a native amount (e.g. a fee) to its EVM-side value.
+inline intx::uint256 to_evm_amount(uint64_t amount, const precision_scale &scale) {
+    if (scale.multiplier != 0) {
+        return intx::uint256(intx::uint128(amount) * scale.multiplier);
+    }
+    return intx::uint256(amount) * pow10_u256(scale.delta);
+}
+
+}  // namespace evmutil
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <algorithm>
+#include <limits>
+#include <optional>
 #include <eosio/eosio.hpp>
 #include <eosio/fixed_bytes.hpp>
 #include <eosio/asset.hpp>
@@ -12,23 +15,46 @@ namespace evmutil {
     struct [[eosio::table("implcontract")]] [[eosio::contract("evmutil")]] impl_contract_t {
         uint64_t id = 0;
         bytes address;
+        binary_extension<uint32_t> proxy_count;  // proxies and beacon running this version, absent on rows registered before tracking
 
         uint64_t primary_key() const {
             return id;
         }
-        EOSLIB_SERIALIZE(impl_contract_t, (id)(address));
+        EOSLIB_SERIALIZE(impl_contract_t, (id)(address)(proxy_count));
     };
     typedef eosio::multi_index<"implcontract"_n, impl_contract_t> impl_contract_table_t;
 
+    // Current stake helper implementation used for new proxies and upgrades, and the one behind the beacon.
+    // Without this singleton the latest implcontract row is current.
+    struct [[eosio::table("implreg")]] [[eosio::contract("evmutil")]] impl_registry_t {
+        uint64_t                current_id = 0;
+        std::optional<uint64_t> beacon_impl_id;
+
+        EOSLIB_SERIALIZE(impl_registry_t, (current_id)(beacon_impl_id));
+    };
+    typedef eosio::singleton<"implreg"_n, impl_registry_t> impl_registry_singleton_t;
+
+    // Running recount of implcontract references by recountimpl(). Reference changes are blocked while it exists.
+    struct [[eosio::table("implcount")]] [[eosio::contract("evmutil")]] impl_recount_t {
+        uint64_t cursor = 0;          // route key to resume from
+        uint64_t legacy_impl_id = 0;  // implementation of the proxies registered before references were counted
+
+        EOSLIB_SERIALIZE(impl_recount_t, (cursor)(legacy_impl_id));
+    };
+    typedef eosio::singleton<"implcount"_n, impl_recount_t> impl_recount_singleton_t;
+
     struct [[eosio::table("helpers")]] [[eosio::contract("evmutil")]] helpers_t {
         bytes reward_helper_address;
         binary_extension<bytes> btc_deposit_address;
         binary_extension<bytes> xsat_deposit_address;
         binary_extension<bytes> gas_funds_address;
-        EOSLIB_SERIALIZE(helpers_t, (reward_helper_address)(btc_deposit_address)(xsat_deposit_address)(gas_funds_address));
+        binary_extension<bytes> deploy_factory_address;  // CREATE2 factory used for deployments when not empty
+        binary_extension<bytes> beacon_address;          // StakeHelperBeacon shared by the beacon proxies
+        EOSLIB_SERIALIZE(helpers_t, (reward_helper_address)(btc_deposit_address)(xsat_deposit_address)(gas_funds_address)(deploy_factory_address)(beacon_address));
     };
     typedef eosio::singleton<"helpers"_n, helpers_t> helpers_singleton_t;
 
+    // Legacy token registry, only read by migtokens() to move its rows to "tokens2".
     struct [[eosio::table("tokens")]] [[eosio::contract("evmutil")]] token_t {
         uint64_t id = 0;
         bytes address;  // <-- proxy contract addr
@@ -51,6 +77,261 @@ namespace evmutil {
                                indexed_by<"by.address"_n, const_mem_fun<token_t, checksum256, &token_t::by_address> > >
         token_table_t;
 
+    // Compact token registry replacing "tokens": fixed-width addresses and 64-bit secondary keys folded by route_key().
+    // Rows sharing a folded key are told apart by the full address, see find_token().
+    struct [[eosio::table("tokens2")]] [[eosio::contract("evmutil")]] token2_t {
+        uint64_t    id = 0;
+        checksum160 address;              // stake helper proxy
+        checksum160 token_address;        // ERC-20 token
+        uint8_t     erc20_precision = 0;
+        uint64_t    multiplier = 0;       // 10^(ERC-20 precision minus native precision) when it fits in 64 bits, 0 otherwise
+
+        uint64_t primary_key() const {
+            return id;
+        }
+        uint64_t by_address() const {
+            return route_key(address);
+        }
+        uint64_t by_token_address() const {
+            return route_key(token_address);
+        }
+        EOSLIB_SERIALIZE(token2_t, (id)(address)(token_address)(erc20_precision)(multiplier));
+    };
+    typedef eosio::multi_index<"tokens2"_n, token2_t,
+                               indexed_by<"by.tokenaddr"_n, const_mem_fun<token2_t, uint64_t, &token2_t::by_token_address> >,
+                               indexed_by<"by.address"_n, const_mem_fun<token2_t, uint64_t, &token2_t::by_address> > >
+        token2_table_t;
+
+    // Finds the token whose `field` equals `addr` through the secondary index keyed by route_key() of that field.
+    template <typename Index>
+    auto find_token(const Index &index, checksum160 token2_t::*field, const checksum160 &addr) {
+        const uint64_t key = route_key(addr);
+        for (auto itr = index.lower_bound(key); itr != index.end() && route_key((*itr).*field) == key; ++itr) {
+            if ((*itr).*field == addr) return itr;
+        }
+        return index.end();
+    }
+
+    enum class route_kind : uint8_t {
+        rewards      = 0,  // synchronizer reward helper
+        btc_deposit  = 1,  // validator deposit helper for BTC
+        xsat_deposit = 2,  // validator deposit helper for XSAT
+        gas_funds    = 3,  // gas funds helper
+        erc20_stake  = 4   // stake helper proxy of a registered ERC-20 token
+    };
+
+    enum class proxy_mode : uint8_t {
+        erc1967 = 0,  // full Erc20Proxy from proxy.sol
+        minimal = 1,  // MinimalProxy from minimal_proxy.sol, same constructor and upgrade path with a tiny runtime
+        beacon  = 2   // BeaconProxy from beacon_proxy.sol, upgraded all at once through the StakeHelperBeacon
+    };
+
+    // One row per EVM contract allowed to send bridge messages, keyed by route_key() of its address.
+    struct [[eosio::table("routes")]] [[eosio::contract("evmutil")]] route_t {
+        static constexpr uint64_t untracked_impl = std::numeric_limits<uint64_t>::max();
+
+        uint64_t    key = 0;
+        checksum160 sender;
+        uint8_t     kind = 0;
+        uint8_t     delta_precision = 0;  // ERC-20 precision minus native token precision
+        uint64_t    multiplier = 0;       // 10^delta_precision when it fits in 64 bits, 0 otherwise
+        binary_extension<uint64_t> impl_id;      // implcontract row a stake helper proxy runs, or untracked_impl
+        binary_extension<uint8_t>  deploy_mode;  // proxy_mode a stake helper proxy was deployed with, when recorded
+
+        uint64_t primary_key() const {
+            return key;
+        }
+        route_kind get_kind() const {
+            return static_cast<route_kind>(kind);
+        }
+        std::optional<uint64_t> tracked_impl() const {
+            if (!impl_id.has_value() || impl_id.value() == untracked_impl) return std::nullopt;
+            return impl_id.value();
+        }
+        // Beacon proxies keep the beacon in their ERC-1967 slot and cannot be upgraded one by one.
+        bool is_beacon_proxy() const {
+            return deploy_mode.has_value() && deploy_mode.value() == uint8_t(proxy_mode::beacon);
+        }
+        EOSLIB_SERIALIZE(route_t, (key)(sender)(kind)(delta_precision)(multiplier)(impl_id)(deploy_mode));
+    };
+    typedef eosio::multi_index<"routes"_n, route_t> route_table_t;
+
+    // Kinds of EVM contract bytecode kept in the bytecode store, used as its table scope.
+    namespace code_kind {
+        constexpr eosio::name stake_helper  = "stakehelper"_n;
+        constexpr eosio::name reward_helper = "rwdhelper"_n;
+        constexpr eosio::name gas_funds     = "gasfunds"_n;
+        constexpr eosio::name proxy         = "proxy"_n;
+        constexpr eosio::name minimal_proxy = "minproxy"_n;
+        constexpr eosio::name deploy_factory = "dpyfactory"_n;
+        constexpr eosio::name beacon        = "beacon"_n;
+        constexpr eosio::name beacon_proxy  = "beaconproxy"_n;
+
+        constexpr eosio::name all[] = {stake_helper, reward_helper, gas_funds, proxy, minimal_proxy, deploy_factory, beacon, beacon_proxy};
+
+        constexpr bool is_known(eosio::name kind) {
+            for (auto known : all) {
+                if (kind == known) return true;
+            }
+            return false;
+        }
+    }
+
+    // One row per uploaded bytecode version, scoped by code_kind. Only finalized versions are deployed.
+    struct [[eosio::table("bytecodes")]] [[eosio::contract("evmutil")]] bytecode_t {
+        uint32_t    version = 0;
+        uint32_t    size = 0;
+        uint32_t    chunk_count = 0;
+        bool        finalized = false;
+        checksum256 hash;  // sha256 of the whole bytecode, checked on finalize
+
+        uint64_t primary_key() const {
+            return version;
+        }
+        EOSLIB_SERIALIZE(bytecode_t, (version)(size)(chunk_count)(finalized)(hash));
+    };
+    typedef eosio::multi_index<"bytecodes"_n, bytecode_t> bytecode_table_t;
+
+    // Bytecode chunks in upload order, scoped by code_kind and keyed by chunk_key().
+    struct [[eosio::table("codechunks")]] [[eosio::contract("evmutil")]] code_chunk_t {
+        uint64_t id = 0;
+        bytes    data;
+
+        static constexpr uint64_t chunk_key(uint32_t version, uint32_t index) {
+            return (uint64_t(version) << 32) | index;
+        }
+        uint64_t primary_key() const {
+            return id;
+        }
+        EOSLIB_SERIALIZE(code_chunk_t, (id)(data));
+    };
+    typedef eosio::multi_index<"codechunks"_n, code_chunk_t> code_chunk_table_t;
+
+    // Admin operations that a fleet job applies to every stake helper proxy.
+    namespace fleet_op {
+        constexpr eosio::name set_fee       = "setdepfee"_n;
+        constexpr eosio::name set_lock_time = "setlocktime"_n;
+        constexpr eosio::name upgrade_impl  = "upstakeimpl"_n;
+        constexpr eosio::name collect_fee   = "collectfee"_n;
+    }
+
+    // Cursor positions of the BTC and XSAT deposit helpers. Registered tokens follow at their id plus fleet_token_cursor.
+    constexpr uint64_t fleet_btc_deposit_cursor  = 0;
+    constexpr uint64_t fleet_xsat_deposit_cursor = 1;
+    constexpr uint64_t fleet_token_cursor        = 2;
+    constexpr uint32_t max_fleet_chunk           = 50;
+
+    // The running fleet job, if any. Every proxy receives the same call, with `arg` as its 32-byte argument word.
+    struct [[eosio::table("fleetjob")]] [[eosio::contract("evmutil")]] fleet_job_t {
+        eosio::name op;
+        bytes       arg;
+        uint64_t    cursor = 0;     // next position to visit
+        uint32_t    processed = 0;  // proxies called so far
+        uint64_t    impl_id = 0;    // implcontract row of the upgrade target, for upstakeimpl
+
+        EOSLIB_SERIALIZE(fleet_job_t, (op)(arg)(cursor)(processed)(impl_id));
+    };
+    typedef eosio::singleton<"fleetjob"_n, fleet_job_t> fleet_job_singleton_t;
+
+    // Factory deployments made so far per CREATE2 salt, keyed by deploy_count_key(). The count is stamped into the
+    // next salt, so the address of the next deployment only depends on this table.
+    struct [[eosio::table("deploycount")]] [[eosio::contract("evmutil")]] deploy_count_t {
+        uint64_t key = 0;
+        uint64_t count = 0;
+
+        uint64_t primary_key() const {
+            return key;
+        }
+        EOSLIB_SERIALIZE(deploy_count_t, (key)(count));
+    };
+    typedef eosio::multi_index<"deploycount"_n, deploy_count_t> deploy_count_table_t;
+
+    // Bridge calls queued by onbridgemsg and dispatched later by process(), per kind of sending route.
+    struct queued_call_t {
+        uint8_t  kind = 0;  // route_kind of the sender
+        uint32_t selector = 0;
+
+        bool operator==(const queued_call_t &o) const {
+            return kind == o.kind && selector == o.selector;
+        }
+        EOSLIB_SERIALIZE(queued_call_t, (kind)(selector));
+    };
+
+    constexpr uint32_t default_max_queue_length = 1000;
+
+    struct [[eosio::table("queuecfg")]] [[eosio::contract("evmutil")]] queue_config_t {
+        std::vector<queued_call_t> calls;
+        uint32_t max_length = default_max_queue_length;  // messages beyond it are dispatched inline
+
+        bool queued(uint32_t selector) const {
+            return std::any_of(calls.begin(), calls.end(), [&](const auto &c) { return c.selector == selector; });
+        }
+        bool queued(route_kind kind, uint32_t selector) const {
+            return std::find(calls.begin(), calls.end(), queued_call_t{uint8_t(kind), selector}) != calls.end();
+        }
+        EOSLIB_SERIALIZE(queue_config_t, (calls)(max_length));
+    };
+    typedef eosio::singleton<"queuecfg"_n, queue_config_t> queue_config_singleton_t;
+
+    constexpr uint32_t max_queue_batch = 50;
+
+    // Queued bridge messages in arrival order. Only the sender and the call data are needed to dispatch them again.
+    struct [[eosio::table("msgqueue")]] [[eosio::contract("evmutil")]] queued_msg_t {
+        uint64_t    id = 0;
+        checksum160 sender;
+        bytes       data;
+
+        uint64_t primary_key() const {
+            return id;
+        }
+        EOSLIB_SERIALIZE(queued_msg_t, (id)(sender)(data));
+    };
+    typedef eosio::multi_index<"msgqueue"_n, queued_msg_t> queued_msg_table_t;
+
+    // Claims that can be coalesced, each identified by (proxy, staker, target, variant) within its kind.
+    enum class claim_kind : uint8_t {
+        endorser       = 0,  // endrmng evmclaim for (proxy, staker, validator)
+        validator      = 1,  // endrmng vdrclaim for a validator
+        synchronizer   = 2,  // poolreg claim for a synchronizer
+        endorser_share = 3   // endrmng evmclaim2 for (proxy, staker, validator), the donate rate as variant
+    };
+
+    // Route kinds whose claims are coalesced, one bit per route_kind. Without the row nothing is coalesced.
+    struct [[eosio::table("claimcfg")]] [[eosio::contract("evmutil")]] claim_config_t {
+        uint8_t route_kinds = 0;
+
+        bool coalesced(route_kind kind) const {
+            return (route_kinds >> uint8_t(kind)) & 1;
+        }
+        EOSLIB_SERIALIZE(claim_config_t, (route_kinds));
+    };
+    typedef eosio::singleton<"claimcfg"_n, claim_config_t> claim_config_singleton_t;
+
+    // Stake message options. Without the row StakeHelper transfers are sent as an endrmng unstake followed by a stake.
+    struct [[eosio::table("stakecfg")]] [[eosio::contract("evmutil")]] stake_config_t {
+        bool single_transfer = false;  // send transfers as one endrmng evmtransfer, only once endrmng provides it
+
+        EOSLIB_SERIALIZE(stake_config_t, (single_transfer));
+    };
+    typedef eosio::singleton<"stakecfg"_n, stake_config_t> stake_config_singleton_t;
+
+    // Direct-mapped log of recent claims: a claim hashes to one slot, whose row is overwritten in place.
+    // A claim whose tag is already in its slot for the current block is skipped. Evicting a tag only lets
+    // a redundant claim through, so a small fixed number of slots is enough.
+    constexpr uint64_t claim_log_slots = 256;
+
+    struct [[eosio::table("claimlog")]] [[eosio::contract("evmutil")]] claim_log_t {
+        uint64_t slot = 0;
+        uint64_t tag = 0;
+        uint32_t block_num = 0;
+
+        uint64_t primary_key() const {
+            return slot;
+        }
+        EOSLIB_SERIALIZE(claim_log_t, (slot)(tag)(block_num));
+    };
+    typedef eosio::multi_index<"claimlog"_n, claim_log_t> claim_log_table_t;
+
     struct [[eosio::table("config")]] [[eosio::contract("evmutil")]] config_t {
         uint64_t      evm_gaslimit = default_evm_gaslimit;
         uint64_t      evm_init_gaslimit = default_evm_init_gaslimit;
@@ -59,11 +340,133 @@ namespace evmutil {
         eosio::name   endrmng_account = default_endrmng_account;
         eosio::name   poolreg_account = default_poolreg_account;
         binary_extension<eosio::name> gasfund_account{default_gasfund_account};
+        binary_extension<uint8_t> stake_proxy_mode{uint8_t(proxy_mode::erc1967)};
 
+        proxy_mode get_proxy_mode() const {
+            return stake_proxy_mode.has_value() ? static_cast<proxy_mode>(stake_proxy_mode.value()) : proxy_mode::erc1967;
+        }
 
-        EOSLIB_SERIALIZE(config_t, (evm_gaslimit)(evm_init_gaslimit)(evm_account)(evm_gas_token_symbol)(endrmng_account)(poolreg_account)(gasfund_account));
+        EOSLIB_SERIALIZE(config_t, (evm_gaslimit)(evm_init_gaslimit)(evm_account)(evm_gas_token_symbol)(endrmng_account)(poolreg_account)(gasfund_account)(stake_proxy_mode));
     };
     typedef eosio::singleton<"config"_n, config_t> config_singleton_t;
 
+    // Fixed-size config_t and helpers_t, stored raw under "state" in table "state" and read with a single db_get_i64
+    // into this struct. It replaces the config and helpers singletons: migconfig() moves them here and erases them,
+    // contracts deployed after it only ever write this record. It is not in the ABI, getconfig() decodes it.
+    // Layout (little-endian, packed): version u32, flags u8, evm_gaslimit u64, evm_init_gaslimit u64, evm_account,
+    // evm_gas_token_symbol, endrmng_account, poolreg_account and gasfund_account u64 each, stake_proxy_mode u8,
+    // helpers_present u8, helpers_set u8, then 20 bytes per helper_slot.
+    struct __attribute__((packed)) state_record {
+        static constexpr eosio::name table = "state"_n;
+        static constexpr uint32_t    current_version = 1;
+
+        enum helper_slot : uint8_t { reward_helper, btc_deposit, xsat_deposit, gas_funds, deploy_factory, beacon, helper_count };
+        enum flag : uint8_t {
+            has_config          = 1 << 0,
+            has_helpers         = 1 << 1,
+            has_gasfund_account = 1 << 2,
+            has_proxy_mode      = 1 << 3
+        };
+
+        uint32_t version = current_version;
+        uint8_t  flags = 0;
+        uint64_t evm_gaslimit = 0;
+        uint64_t evm_init_gaslimit = 0;
+        uint64_t evm_account = 0;
+        uint64_t evm_gas_token_symbol = 0;
+        uint64_t endrmng_account = 0;
+        uint64_t poolreg_account = 0;
+        uint64_t gasfund_account = 0;
+        uint8_t  stake_proxy_mode = 0;
+        uint8_t  helpers_present = 0;  // bit per helper_slot: binary extension present
+        uint8_t  helpers_set = 0;      // bit per helper_slot: address not empty
+        uint8_t  helpers[helper_count][kAddressLength] = {};
+
+        // Bridge messages read these directly, without unpacking config_t or helpers_t.
+        eosio::name evm() const { return eosio::name(evm_account); }
+        eosio::name endrmng() const { return eosio::name(endrmng_account); }
+        eosio::name poolreg() const { return eosio::name(poolreg_account); }
+        eosio::symbol gas_token() const { return eosio::symbol(evm_gas_token_symbol); }
+        eosio::name gasfund() const {
+            eosio::check(flags & has_gasfund_account, "gas funds account not set");
+            return eosio::name(gasfund_account);
+        }
+        // The 20 address bytes of a helper, or nullptr when it is not set.
+        const uint8_t *helper(helper_slot slot) const {
+            return (helpers_set & (1 << slot)) ? helpers[slot] : nullptr;
+        }
+
+        void set_config(const config_t &v) {
+            flags |= has_config;
+            evm_gaslimit = v.evm_gaslimit;
+            evm_init_gaslimit = v.evm_init_gaslimit;
+            evm_account = v.evm_account.value;
+            evm_gas_token_symbol = v.evm_gas_token_symbol.raw();
+            endrmng_account = v.endrmng_account.value;
+            poolreg_account = v.poolreg_account.value;
+            flags &= ~(has_gasfund_account | has_proxy_mode);
+            if (v.gasfund_account.has_value()) {
+                flags |= has_gasfund_account;
+                gasfund_account = v.gasfund_account.value().value;
+            }
+            if (v.stake_proxy_mode.has_value()) {
+                flags |= has_proxy_mode;
+                stake_proxy_mode = v.stake_proxy_mode.value();
+            }
+        }
+
+        void get_config(config_t &v) const {
+            v.evm_gaslimit = evm_gaslimit;
+            v.evm_init_gaslimit = evm_init_gaslimit;
+            v.evm_account = eosio::name(evm_account);
+            v.evm_gas_token_symbol = eosio::symbol(evm_gas_token_symbol);
+            v.endrmng_account = eosio::name(endrmng_account);
+            v.poolreg_account = eosio::name(poolreg_account);
+            v.gasfund_account.reset();
+            v.stake_proxy_mode.reset();
+            if (flags & has_gasfund_account) v.gasfund_account.emplace(eosio::name(gasfund_account));
+            if (flags & has_proxy_mode) v.stake_proxy_mode.emplace(stake_proxy_mode);
+        }
+
+        void set_helpers(const helpers_t &v) {
+            flags |= has_helpers;
+            helpers_present = 0;
+            helpers_set = 0;
+            set_helper(reward_helper, &v.reward_helper_address);
+            set_helper(btc_deposit, v.btc_deposit_address ? &v.btc_deposit_address.value() : nullptr);
+            set_helper(xsat_deposit, v.xsat_deposit_address ? &v.xsat_deposit_address.value() : nullptr);
+            set_helper(gas_funds, v.gas_funds_address ? &v.gas_funds_address.value() : nullptr);
+            set_helper(deploy_factory, v.deploy_factory_address ? &v.deploy_factory_address.value() : nullptr);
+            set_helper(beacon, v.beacon_address ? &v.beacon_address.value() : nullptr);
+        }
+
+        void get_helpers(helpers_t &v) const {
+            v = helpers_t();
+            v.reward_helper_address = get_helper(reward_helper);
+            if (helpers_present & (1 << btc_deposit)) v.btc_deposit_address.emplace(get_helper(btc_deposit));
+            if (helpers_present & (1 << xsat_deposit)) v.xsat_deposit_address.emplace(get_helper(xsat_deposit));
+            if (helpers_present & (1 << gas_funds)) v.gas_funds_address.emplace(get_helper(gas_funds));
+            if (helpers_present & (1 << deploy_factory)) v.deploy_factory_address.emplace(get_helper(deploy_factory));
+            if (helpers_present & (1 << beacon)) v.beacon_address.emplace(get_helper(beacon));
+        }
+
+       private:
+        void set_helper(helper_slot slot, const bytes *addr) {
+            memset(helpers[slot], 0, kAddressLength);
+            if (!addr) return;
+            helpers_present |= 1 << slot;
+            if (addr->empty()) return;
+            eosio::check(addr->size() == kAddressLength, "invalid length of helper address");
+            helpers_set |= 1 << slot;
+            memcpy(helpers[slot], addr->data(), kAddressLength);
+        }
+
+        bytes get_helper(helper_slot slot) const {
+            if (!(helpers_set & (1 << slot))) return bytes();
+            return bytes((const char *)helpers[slot], (const char *)helpers[slot] + kAddressLength);
+        }
+    };
+    static_assert(std::is_trivially_copyable<state_record>::value, "state_record is read and written as raw bytes");
+
 } // namespace evmutil
 #include <evmutil/types.hpp>
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <eosio/eosio.hpp>
+#include <eosio/asset.hpp>
 #include <intx/intx.hpp>
 
 using namespace eosio;
@@ -36,6 +37,141 @@ struct bridge_message_v0 {
 
 using bridge_message_t = std::variant<bridge_message_v0>;
 
+struct token_spec {
+    std::string  token_address;
+    eosio::asset dep_fee;
+    uint8_t      erc20_precision = 0;
+
+    EOSLIB_SERIALIZE(token_spec, (token_address)(dep_fee)(erc20_precision));
+};
+
+/// Row count and serialized size of one table scope, as returned by getstats.
+struct table_stats {
+    eosio::name table;
+    eosio::name scope;
+    uint32_t    rows = 0;
+    uint64_t    total_size = 0;    // serialized bytes over all rows, without the per-row RAM overhead
+    uint64_t    largest_key = 0;   // primary key of the largest row
+    uint32_t    largest_size = 0;
+    bool        complete = true;   // false when the scan stopped at max_rows
+
+    EOSLIB_SERIALIZE(table_stats, (table)(scope)(rows)(total_size)(largest_key)(largest_size)(complete));
+};
+
+/// Inline action a bridge message would emit, as returned by simulate.
+/// `data` stays packed; callers decode it with the ABI of `account`.
+struct simulated_action {
+    eosio::name                          account;
+    eosio::name                          name;
+    std::vector<eosio::permission_level> authorization;
+    bytes                                data;
+
+    EOSLIB_SERIALIZE(simulated_action, (account)(name)(authorization)(data));
+};
+
+/// One route in the merged view returned by getroutes.
+struct route_info {
+    uint64_t    key = 0;
+    std::string address;          // proxy or helper contract, 0x hex
+    std::string token_address;    // ERC-20 token of a registered token, empty for other kinds
+    uint8_t     kind = 0;         // route_kind
+    uint8_t     erc20_precision = 0;
+
+    EOSLIB_SERIALIZE(route_info, (key)(address)(token_address)(kind)(erc20_precision));
+};
+
+/// A page of getroutes. `next_key` is the lower bound of the next page, absent on the last page.
+struct route_page {
+    std::vector<route_info> routes;
+    std::optional<uint64_t> next_key;
+
+    EOSLIB_SERIALIZE(route_page, (routes)(next_key));
+};
+
+constexpr uint32_t max_route_page = 100;
+
+/// Config and helper addresses decoded from the raw state record by getconfig. Helpers are 0x hex, empty when not set.
+struct config_info {
+    uint64_t      evm_gaslimit = 0;
+    uint64_t      evm_init_gaslimit = 0;
+    eosio::name   evm_account;
+    eosio::symbol evm_gas_token_symbol;
+    eosio::name   endrmng_account;
+    eosio::name   poolreg_account;
+    eosio::name   gasfund_account;  // empty when not set
+    uint8_t       stake_proxy_mode = 0;
+    std::string   reward_helper_address;
+    std::string   btc_deposit_address;
+    std::string   xsat_deposit_address;
+    std::string   gas_funds_address;
+    std::string   deploy_factory_address;
+    std::string   beacon_address;
+
+    EOSLIB_SERIALIZE(config_info, (evm_gaslimit)(evm_init_gaslimit)(evm_account)(evm_gas_token_symbol)(endrmng_account)
+                                  (poolreg_account)(gasfund_account)(stake_proxy_mode)(reward_helper_address)(btc_deposit_address)
+                                  (xsat_deposit_address)(gas_funds_address)(deploy_factory_address)(beacon_address));
+};
+
+/// Read-only window over bytes owned elsewhere, e.g. the action data buffer of onbridgemsg.
+class byte_span {
+   public:
+    constexpr byte_span() = default;
+    constexpr byte_span(const char *data, size_t size) : _data(data), _size(size) {}
+    byte_span(const bytes &b) : _data(b.data()), _size(b.size()) {}
+
+    constexpr const char *data() const { return _data; }
+    constexpr size_t size() const { return _size; }
+    constexpr bool empty() const { return _size == 0; }
+    constexpr const char *begin() const { return _data; }
+    constexpr const char *end() const { return _data + _size; }
+    constexpr char operator[](size_t i) const { return _data[i]; }
+
+   private:
+    const char *_data = nullptr;
+    size_t      _size = 0;
+};
+
+/// bridge_message_v0 with its byte fields left in place as spans over the serialized message.
+struct bridge_message_view {
+    eosio::name       receiver;
+    byte_span         sender;
+    eosio::time_point timestamp;
+    byte_span         value;
+    byte_span         data;
+
+    static bridge_message_view from(const bridge_message_v0 &msg) {
+        return {msg.receiver, msg.sender, msg.timestamp, msg.value, msg.data};
+    }
+
+    /// Parses a packed bridge_message_t. The returned spans point into `buf`, which must outlive the view.
+    static bridge_message_view parse(const char *buf, size_t size) {
+        eosio::datastream<const char *> ds(buf, size);
+
+        unsigned_int index;
+        ds >> index;
+        check(index.value == 0, "unsupported bridge_message version");
+
+        bridge_message_view view;
+        ds >> view.receiver;
+        view.sender = read_span(ds);
+        ds >> view.timestamp;
+        view.value = read_span(ds);
+        view.data = read_span(ds);
+        check(ds.remaining() == 0, "unexpected trailing data in bridge_message_v0");
+        return view;
+    }
+
+   private:
+    static byte_span read_span(eosio::datastream<const char *> &ds) {
+        unsigned_int len;
+        ds >> len;
+        check(ds.remaining() >= len.value, "not enough data in bridge_message_v0");
+        byte_span span(ds.pos(), len.value);
+        ds.skip(len.value);
+        return span;
+    }
+};
+
 checksum256 make_key(const uint8_t *ptr, size_t len) {
     uint8_t buffer[32] = {};
     check(len <= sizeof(buffer), "len provided to make_key is too small");
@@ -58,4 +194,35 @@ checksum160 make_key160(bytes data) {
     return make_key160((const uint8_t *)data.data(), data.size());
 }
 
+checksum160 make_key160(const byte_span &data) {
+    return make_key160((const uint8_t *)data.data(), data.size());
+}
+
+// Folds a 20-byte EVM address into a 64-bit primary key.
+// Lookups must still compare the full address stored in the row.
+inline uint64_t route_key(const uint8_t *addr) {
+    uint64_t hi = 0, mid = 0;
+    uint32_t lo = 0;
+    memcpy(&hi, addr, sizeof(hi));
+    memcpy(&mid, addr + 8, sizeof(mid));
+    memcpy(&lo, addr + 16, sizeof(lo));
+    return hi ^ mid ^ lo;
+}
+
+inline uint64_t route_key(const byte_span &addr) {
+    check(addr.size() == kAddressLength, "invalid length of address");
+    return route_key((const uint8_t *)addr.data());
+}
+
+inline uint64_t route_key(const checksum160 &addr) {
+    const auto raw = addr.extract_as_byte_array();
+    return route_key(raw.data());
+}
+
+// The 20 address bytes of a checksum160 key, e.g. to call the address in EVM.
+inline bytes key160_bytes(const checksum160 &key) {
+    const auto raw = key.extract_as_byte_array();
+    return bytes(raw.begin(), raw.end());
+}
+
 }  // namespace evmutil
\ No newline at end of file
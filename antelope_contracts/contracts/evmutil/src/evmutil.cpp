@@ -6,14 +6,10 @@
 #include <evmutil/gasfunds.hpp>
 #include <evmutil/poolreg.hpp>
 #include <evmutil/types.hpp>
+#include <evmutil/encoder.hpp>
+#include <evmutil/address.hpp>
+#include <eosio/crypto.hpp>
 
-#include <evmutil/reward_helper_bytecode.hpp>
-#include <evmutil/stake_helper_bytecode.hpp>
-#include <evmutil/gas_funds_bytecode.hpp>
-#include <proxy/proxy_bytecode.hpp>
-
-#include <silkworm/core/execution/address.hpp>
-#include <silkworm/core/common/util.hpp>
 
 namespace eosio {
    namespace internal_use_do_not_use {
@@ -28,46 +24,6 @@ namespace eosio {
 // Local helpers
 namespace {
 
-void readUint256(const evmutil::bytes &data, size_t offset, intx::uint256 &output) {
-    auto read_uint256 = [&](const auto &data, size_t offset) -> intx::uint256 {
-            uint8_t buffer[32]={};
-            check(data.size() >= offset + 32, "not enough data in bridge_message_v0");
-            memcpy(buffer, (void *)&(data[offset]), 32);
-            return intx::be::load<intx::uint256>(buffer);
-    };
-    output = read_uint256(data, offset);
-}
-
-void readEvmAddress(const evmutil::bytes &data, size_t offset, evmc::address &output) {
-    intx::uint256 value;
-    readUint256(data, offset, value);
-    check(value <= 0xffffFFFFffffFFFFffffFFFFffffFFFFffffFFFF_u256, "invalid evm address");
-
-    memcpy(output.bytes, (void *)&(data[offset+ 32 - evmutil::kAddressLength]), evmutil::kAddressLength);
-}
-
-void readExSatAccount(const evmutil::bytes &data, size_t offset, uint64_t &output) {
-    evmc::address dest_addr;
-    readEvmAddress(data, offset, dest_addr);
-
-    std::optional<uint64_t> dest_acc = silkworm::extract_reserved_address(dest_addr);
-    check(!!dest_acc, "destination address in bridge_message_v0 must be reserved address");
-    output = *dest_acc;
-}
-
-void readTokenAmount(const evmutil::bytes &data, size_t offset, uint64_t &output, uint64_t delta_precision) {
-    intx::uint256 value;
-    readUint256(data, offset, value);
-
-    intx::uint256 mult = intx::exp(10_u256, intx::uint256(delta_precision));
-    check(value % mult == 0_u256, "bridge amount can not have dust");
-    value /= mult;
-
-    output = (uint64_t)value;
-    check(intx::uint256(output) == value && output < (1ull<<62)-1, "bridge amount value overflow");
-    check(output > 0, "bridge amount must be positive");
-}
-
 checksum256 get_code_hash(name account) {
     char buff[64];
 
@@ -85,11 +41,18 @@ inline uint128_t token_symbol_key(eosio::name token_contract, eosio::symbol_code
     return v;
 }
 
-template <size_t Size>
-void initialize_data(evmutil::bytes& output, const unsigned char (&arr)[Size]) {
-    static_assert(Size > 128); // ensure bytecode is compiled
-    output.resize(Size);
-    std::memcpy(output.data(), arr, Size);
+// Earlier binary extensions of helpers_t must be present for a later one to be serialized.
+void emplace_helper_extensions(evmutil::helpers_t &helpers) {
+    if (!helpers.btc_deposit_address.has_value()) helpers.btc_deposit_address.emplace();
+    if (!helpers.xsat_deposit_address.has_value()) helpers.xsat_deposit_address.emplace();
+    if (!helpers.gas_funds_address.has_value()) helpers.gas_funds_address.emplace();
+    if (!helpers.deploy_factory_address.has_value()) helpers.deploy_factory_address.emplace();
+    if (!helpers.beacon_address.has_value()) helpers.beacon_address.emplace();
+}
+
+void set_deploy_factory(evmutil::helpers_t &helpers, const evmutil::bytes &factory_address) {
+    emplace_helper_extensions(helpers);
+    helpers.deploy_factory_address = factory_address;
 }
 
 } // namespace
@@ -99,35 +62,281 @@ namespace evmutil {
 // Public Helpers
 
 config_t evmutil::get_config() const {
+    state_record state;
+    if (read_state(state) && (state.flags & state_record::has_config)) {
+        config_t v;
+        state.get_config(v);
+        return v;
+    }
+
     config_singleton_t config(get_self(), get_self().value);
     eosio::check(config.exists(), "evmutil config not exist");
     return config.get();
 }
 
 intx::uint256 evmutil::get_minimum_natively_representable(const config_t& config) const {
-    return intx::exp(10_u256, intx::uint256(evm_precision - config.evm_gas_token_symbol.precision()));
+    return pow10_u256(evm_precision - config.evm_gas_token_symbol.precision());
 }
 
 void evmutil::set_config(const config_t &v) {
-    config_singleton_t config(get_self(), get_self().value);
-    config.set(v, get_self());
+    store_state(&v, nullptr);
 }
 
 helpers_t evmutil::get_helpers() const {
+    state_record state;
+    if (read_state(state) && (state.flags & state_record::has_helpers)) {
+        helpers_t v;
+        state.get_helpers(v);
+        return v;
+    }
+
     helpers_singleton_t helpers(get_self(), get_self().value);
     eosio::check(helpers.exists(), "evmutil config not exist");
     return helpers.get();
 }
 
 void evmutil::set_helpers(const helpers_t &v) {
+    store_state(nullptr, &v);
+}
+
+bool evmutil::read_state(state_record &state) const {
+    using namespace eosio::internal_use_do_not_use;
+    int32_t itr = db_find_i64(_self.value, _self.value, state_record::table.value, state_record::table.value);
+    if (itr < 0) return false;
+
+    int32_t size = db_get_i64(itr, &state, sizeof(state));
+    eosio::check(size == sizeof(state) && state.version == state_record::current_version, "unsupported state record version");
+    return true;
+}
+
+void evmutil::write_state(const state_record &state) {
+    using namespace eosio::internal_use_do_not_use;
+    int32_t itr = db_find_i64(_self.value, _self.value, state_record::table.value, state_record::table.value);
+    if (itr < 0) {
+        db_store_i64(_self.value, state_record::table.value, _self.value, state_record::table.value, &state, sizeof(state));
+    }
+    else {
+        db_update_i64(itr, _self.value, &state, sizeof(state));
+    }
+}
+
+// Writes to the layout in use: the singletons until migconfig() ran on an upgraded contract, the state record otherwise.
+void evmutil::store_state(const config_t *config, const helpers_t *helpers) {
+    state_record state;
+    config_singleton_t config_table(get_self(), get_self().value);
+    if (!read_state(state) && config_table.exists()) {
+        if (config) config_table.set(*config, get_self());
+        if (helpers) helpers_singleton_t(get_self(), get_self().value).set(*helpers, get_self());
+        return;
+    }
+
+    if (config) state.set_config(*config);
+    if (helpers) state.set_helpers(*helpers);
+    write_state(state);
+}
+
+bool evmutil::config_initialized() const {
+    state_record state;
+    if (read_state(state)) return state.flags & state_record::has_config;
+    return config_singleton_t(get_self(), get_self().value).exists();
+}
+
+state_record evmutil::current_state() const {
+    state_record state;
+    if (read_state(state)) return state;
+
+    // Not migrated yet, start from whatever the singletons hold.
+    config_singleton_t config(get_self(), get_self().value);
+    if (config.exists()) state.set_config(config.get());
     helpers_singleton_t helpers(get_self(), get_self().value);
-    helpers.set(v, get_self());
+    if (helpers.exists()) state.set_helpers(helpers.get());
+    return state;
 }
 
-// lookup nonce from the multi_index table of evm contract and assert
-uint64_t evmutil::get_next_nonce() {
+action_context evmutil::load_context(bool with_helpers) const {
+    action_context ctx;
+    state_record state;
+    if (read_state(state) && (state.flags & state_record::has_config) && (!with_helpers || (state.flags & state_record::has_helpers))) {
+        // One raw read covers both config and helpers.
+        state.get_config(ctx.config);
+        if (with_helpers) {
+            state.get_helpers(ctx.helpers);
+            ctx.helpers_loaded = true;
+        }
+        return ctx;
+    }
 
-    config_t config = get_config();
+    ctx.config = get_config();
+    if (with_helpers) {
+        ctx.helpers = get_helpers();
+        ctx.helpers_loaded = true;
+    }
+    return ctx;
+}
+
+// Bridge messages only need the raw record: names, the gas token and 20-byte helper addresses are read from it as is.
+action_context evmutil::load_message_context() const {
+    action_context ctx;
+    if (!read_state(ctx.state)) ctx.state = current_state();
+    eosio::check(ctx.state.flags & state_record::has_config, "evmutil config not exist");
+    return ctx;
+}
+
+void evmutil::commit_context(const action_context &ctx) {
+    if (!ctx.config_dirty && !ctx.helpers_dirty) return;
+    eosio::check(!ctx.helpers_dirty || ctx.helpers_loaded, "helpers not loaded in action context");
+
+    // A single record write for both.
+    store_state(ctx.config_dirty ? &ctx.config : nullptr, ctx.helpers_dirty ? &ctx.helpers : nullptr);
+}
+
+void evmutil::migconfig() {
+    require_auth(get_self());
+
+    state_record state;
+    eosio::check(!read_state(state), "config already migrated");
+    config_singleton_t config(get_self(), get_self().value);
+    eosio::check(config.exists(), "evmutil config not exist");
+
+    write_state(current_state());
+    config.remove();
+    helpers_singleton_t(get_self(), get_self().value).remove();
+}
+
+config_info evmutil::getconfig() {
+    const state_record state = load_message_context().state;
+    auto helper = [&](state_record::helper_slot slot) {
+        const uint8_t *addr = state.helper(slot);
+        return addr ? to_hex(addr, kAddressLength) : std::string();
+    };
+
+    config_info info;
+    info.evm_gaslimit = state.evm_gaslimit;
+    info.evm_init_gaslimit = state.evm_init_gaslimit;
+    info.evm_account = state.evm();
+    info.evm_gas_token_symbol = state.gas_token();
+    info.endrmng_account = state.endrmng();
+    info.poolreg_account = state.poolreg();
+    if (state.flags & state_record::has_gasfund_account) info.gasfund_account = state.gasfund();
+    info.stake_proxy_mode = state.stake_proxy_mode;
+    info.reward_helper_address = helper(state_record::reward_helper);
+    info.btc_deposit_address = helper(state_record::btc_deposit);
+    info.xsat_deposit_address = helper(state_record::xsat_deposit);
+    info.gas_funds_address = helper(state_record::gas_funds);
+    info.deploy_factory_address = helper(state_record::deploy_factory);
+    info.beacon_address = helper(state_record::beacon);
+    return info;
+}
+
+
+route_table_t::const_iterator evmutil::find_route(const route_table_t &routes, const byte_span &sender) const {
+    auto itr = routes.find(route_key(sender));
+    if (itr != routes.end() && itr->sender != make_key160(sender)) return routes.end();
+    return itr;
+}
+
+void evmutil::set_route(const bytes &sender, route_kind kind, uint8_t delta_precision) {
+    route_table_t routes(_self, _self.value);
+    checksum160 sender_key = make_key160(sender);
+    auto itr = routes.find(route_key(sender));
+    if (itr == routes.end()) {
+        routes.emplace(_self, [&](auto &v) {
+            v.key = route_key(sender);
+            v.sender = sender_key;
+            v.kind = static_cast<uint8_t>(kind);
+            v.delta_precision = delta_precision;
+            v.multiplier = precision_scale::of(delta_precision).multiplier;
+        });
+    }
+    else {
+        eosio::check(itr->sender == sender_key, "route key collision");
+        routes.modify(itr, _self, [&](auto &v) {
+            v.kind = static_cast<uint8_t>(kind);
+            v.delta_precision = delta_precision;
+            v.multiplier = precision_scale::of(delta_precision).multiplier;
+        });
+    }
+}
+
+std::optional<route_t> evmutil::find_legacy_route(const state_record &state, const byte_span &sender) const {
+    // After migtokens every registered sender has a route, so unknown senders stop here.
+    // A contract without legacy tokens keeps the fallback until syncroutes wrote its first route.
+    token_table_t token_table(_self, _self.value);
+    if (token_table.begin() == token_table.end()) {
+        route_table_t routes(_self, _self.value);
+        if (routes.begin() != routes.end()) return std::nullopt;
+    }
+
+    auto make_route = [&](route_kind kind, uint8_t delta_precision) {
+        route_t v;
+        v.key = route_key(sender);
+        v.sender = make_key160(sender);
+        v.kind = static_cast<uint8_t>(kind);
+        v.delta_precision = delta_precision;
+        v.multiplier = precision_scale::of(delta_precision).multiplier;
+        return v;
+    };
+    auto matches = [&](const bytes &addr) {
+        return addr.size() == sender.size() && memcmp(addr.data(), sender.data(), sender.size()) == 0;
+    };
+    auto matches_helper = [&](state_record::helper_slot slot) {
+        const uint8_t *addr = state.helper(slot);
+        return addr && memcmp(addr, sender.data(), kAddressLength) == 0;
+    };
+
+    const eosio::symbol gas_token = state.gas_token();
+    if (matches_helper(state_record::reward_helper)) return make_route(route_kind::rewards, 0);
+    if (matches_helper(state_record::btc_deposit)) return make_route(route_kind::btc_deposit, legacy_deposit_delta(gas_token));
+    if (matches_helper(state_record::xsat_deposit)) return make_route(route_kind::xsat_deposit, legacy_deposit_delta(gas_token));
+    if (matches_helper(state_record::gas_funds)) return make_route(route_kind::gas_funds, 0);
+
+    token2_table_t token2_table(_self, _self.value);
+    auto index2 = token2_table.get_index<"by.address"_n>();
+    auto itr2 = find_token(index2, &token2_t::address, make_key160(sender));
+    if (itr2 != index2.end()) return make_route(route_kind::erc20_stake, get_delta_precision(gas_token, itr2->erc20_precision));
+
+    auto index = token_table.get_index<"by.address"_n>();
+    auto itr = index.find(make_key((const uint8_t *)sender.data(), sender.size()));
+    if (itr != index.end() && matches(itr->address)) return make_route(route_kind::erc20_stake, get_delta_precision(gas_token, itr->erc20_precision));
+
+    return std::nullopt;
+}
+
+std::optional<route_t> evmutil::find_proxy_route(const bytes &proxy) const {
+    route_table_t routes(_self, _self.value);
+    auto itr = find_route(routes, proxy);
+    if (itr != routes.end()) return *itr;
+    // Admin actions on upgraded contracts keep working before migtokens and syncroutes ran.
+    return find_legacy_route(current_state(), proxy);
+}
+
+uint8_t evmutil::legacy_deposit_delta(eosio::symbol gas_token) const {
+    // Deposit helpers deployed before the route table always fronted 18-decimal XBTC and XSAT.
+    return get_delta_precision(gas_token, evm_precision);
+}
+
+void evmutil::erase_route(const bytes &sender) {
+    if (sender.size() != kAddressLength) return;
+    route_table_t routes(_self, _self.value);
+    auto itr = find_route(routes, sender);
+    if (itr == routes.end()) return;
+    move_impl_ref(itr->tracked_impl(), std::nullopt);
+    routes.erase(itr);
+}
+
+uint8_t evmutil::get_delta_precision(const config_t &config, uint8_t erc20_precision) const {
+    return get_delta_precision(config.evm_gas_token_symbol, erc20_precision);
+}
+
+uint8_t evmutil::get_delta_precision(eosio::symbol gas_token, uint8_t erc20_precision) const {
+    // 2^(256-64) = 6.2e+57, so the precision diff is at most 57
+    eosio::check(erc20_precision >= gas_token.precision() &&
+    erc20_precision <= gas_token.precision() + 57, "evmutil precision out of range");
+    return erc20_precision - gas_token.precision();
+}
+
+// lookup nonce from the multi_index table of evm contract and assert
+uint64_t evmutil::get_next_nonce(const config_t &config) {
 
     evm_runtime::next_nonce_table table(config.evm_account, config.evm_account.value);
     auto itr = table.find(receiver_account().value);
@@ -138,64 +347,194 @@ uint64_t evmutil::get_next_nonce() {
     return next_nonce;
 }
 
+bytecode_t evmutil::find_code(eosio::name kind) const {
+    bytecode_table_t codes(_self, kind.value);
+    for (auto itr = codes.end(); itr != codes.begin();) {
+        --itr;
+        if (itr->finalized) return *itr;
+    }
+    eosio::check(false, "bytecode not uploaded: " + kind.to_string());
+    return {};
+}
+
+void evmutil::write_code(abi_encoder &out, eosio::name kind, const bytecode_t &code) const {
+    code_chunk_table_t chunks(_self, kind.value);
+    auto itr = chunks.find(code_chunk_t::chunk_key(code.version, 0));
+    for (uint32_t i = 0; i < code.chunk_count; ++i, ++itr) {
+        eosio::check(itr != chunks.end() && itr->id == code_chunk_t::chunk_key(code.version, i), "bytecode chunk missing");
+        out.raw(itr->data.data(), itr->data.size());
+    }
+}
+
+template <typename WriteCode>
+bytes evmutil::deploy_contract(action_context &ctx, size_t code_size, const std::array<uint8_t, 32> &salt, WriteCode write_code) {
+    const bool use_factory = ctx.helpers.deploy_factory_address.has_value() && !ctx.helpers.deploy_factory_address.value().empty();
+    bytes result(kAddressLength, 0);
+
+    if (!use_factory) {
+        auto reserved_addr = make_reserved_address(receiver_account().value);
+        if (!ctx.next_nonce) ctx.next_nonce = get_next_nonce(ctx.config);
+        uint64_t next_nonce = (*ctx.next_nonce)++;
+
+        // required account opened in evm_runtime
+        evm_call_payload payload(receiver_account(), bytes{}, code_size);
+        abi_encoder code = payload.data();
+        write_code(code);
+        code.finish();
+        payload.send(ctx.config.evm_account, {receiver_account(), "active"_n}, ctx.config.evm_init_gaslimit);
+
+        const auto addr = create_address(reserved_addr, next_nonce);
+        memcpy(&(result[0]), addr.data(), kAddressLength);
+        return result;
+    }
+
+    // The first deployment of a salt keeps it as is, every later one (re-registration, same bytecode again) counts up.
+    deploy_count_table_t counts(_self, _self.value);
+    const uint64_t count_key = deploy_count_key(salt);
+    uint64_t count = 0;
+    auto count_itr = counts.find(count_key);
+    if (count_itr == counts.end()) {
+        counts.emplace(_self, [&](auto &v) {
+            v.key = count_key;
+            v.count = 1;
+        });
+    }
+    else {
+        count = count_itr->count;
+        counts.modify(count_itr, eosio::same_payer, [&](auto &v) { ++v.count; });
+    }
+    const auto counted_salt = stamp_deploy_count(salt, count);
+
+    // deploy(bytes32 _salt, bytes _initCode) on the factory
+    const bytes &factory = ctx.helpers.deploy_factory_address.value();
+    evm_call_payload payload(receiver_account(), factory, 4 + 3 * 32 + abi_encoder::padded(code_size));
+    abi_encoder call_data = payload.data();
+    call_data.selector(evm_calls::factory_deploy)
+             .raw(counted_salt.data(), counted_salt.size())
+             .word(64);                                        // offset of _initCode
+
+    size_t code_begin = call_data.begin_bytes(code_size);
+    write_code(call_data);
+    eosio::check(call_data.position() - code_begin == code_size, "abi encoder size mismatch");
+    const auto code_hash = keccak256(call_data.at(code_begin), code_size);
+    call_data.end_bytes(code_begin).finish();
+
+    payload.send(ctx.config.evm_account, {receiver_account(), "active"_n}, ctx.config.evm_init_gaslimit);
+
+    const auto addr = create2_address((const uint8_t *)factory.data(), counted_salt, code_hash);
+    memcpy(&(result[0]), addr.data(), kAddressLength);
+    return result;
+}
+
 // Actions
 
-void evmutil::dpystakeimpl() {
-    require_auth(get_self());
+bytes evmutil::deploy_stake_impl(action_context &ctx) {
+    bytecode_t code = find_code(code_kind::stake_helper);
+    bytes impl_addr = deploy_contract(ctx, code.size, make_deploy_salt(deploy_tag::stake_impl),
+                                      [&](abi_encoder &out) { write_code(out, code_kind::stake_helper, code); });
 
-    bytes call_data;
+    add_impl(impl_addr);
+    return impl_addr;
+}
 
-    auto reserved_addr = silkworm::make_reserved_address(receiver_account().value);
-    initialize_data(call_data, solidity::stakehelper::bytecode);
+void evmutil::deploy_reward_helper(action_context &ctx) {
+    bytecode_t code = find_code(code_kind::reward_helper);
+    bytes impl_addr = deploy_contract(ctx, code.size, make_deploy_salt(deploy_tag::reward_helper),
+                                      [&](abi_encoder &out) { write_code(out, code_kind::reward_helper, code); });
 
-    bytes to = {};
-    bytes value_zero;
-    value_zero.resize(32, 0);
+    erase_route(ctx.helpers.reward_helper_address);
+    ctx.helpers.reward_helper_address = impl_addr;
+    set_route(ctx.helpers.reward_helper_address, route_kind::rewards, 0);
+    ctx.mark_helpers();
+}
 
-    uint64_t next_nonce = get_next_nonce();
+void evmutil::deploy_gas_funds(action_context &ctx) {
+    bytecode_t code = find_code(code_kind::gas_funds);
+    bytes impl_addr_bytes = deploy_contract(ctx, code.size, make_deploy_salt(deploy_tag::gas_funds),
+                                            [&](abi_encoder &out) { write_code(out, code_kind::gas_funds, code); });
+    if (ctx.helpers.gas_funds_address) erase_route(ctx.helpers.gas_funds_address.value());
+    ctx.helpers.gas_funds_address = impl_addr_bytes;
+    set_route(impl_addr_bytes, route_kind::gas_funds, 0);
+    ctx.mark_helpers();
+}
 
-    // required account opened in evm_runtime
-    config_t config = get_config();
-    evm_runtime::call_action call_act(config.evm_account, {{receiver_account(), "active"_n}});
-    call_act.send(receiver_account(), to, value_zero, call_data, config.evm_init_gaslimit);
+void evmutil::deploy_deposit_helper(action_context &ctx, route_kind kind, const token_spec &token) {
+    binary_extension<bytes> &helper_address = kind == route_kind::btc_deposit ? ctx.helpers.btc_deposit_address : ctx.helpers.xsat_deposit_address;
+    eosio::check(!helper_address || helper_address.value().empty(), "cannot deploy again");
 
-    evmc::address impl_addr = silkworm::create_address(reserved_addr, next_nonce);
+    const impl_contract_t impl = current_impl();
 
-    impl_contract_table_t contract_table(_self, _self.value);
-    contract_table.emplace(_self, [&](auto &v) {
-        v.id = contract_table.available_primary_key();
-        v.address.resize(kAddressLength);
-        memcpy(&(v.address[0]), impl_addr.bytes, kAddressLength);
-    });
+    auto token_address_bytes = from_hex(token.token_address);
+    eosio::check(!!token_address_bytes, "token address must be valid 0x EVM address");
+    eosio::check(token_address_bytes->size() == kAddressLength, "invalid length of token address");
+
+    bytes proxy_contract_addr = deploy_stake_helper_proxy(ctx, kind, *token_address_bytes, impl.address, token.dep_fee, token.erc20_precision);
 
+    helper_address = proxy_contract_addr;
+    set_route(proxy_contract_addr, kind, get_delta_precision(ctx.config, token.erc20_precision));
+    // Beacon proxies follow the beacon, which holds its own reference.
+    const proxy_mode mode = ctx.config.get_proxy_mode();
+    set_proxy_impl(proxy_contract_addr, mode == proxy_mode::beacon ? std::nullopt : std::optional<uint64_t>(impl.id), mode);
+    ctx.mark_helpers();
 }
 
-void evmutil::dpyrwdhelper() {
-    require_auth(get_self());
+void evmutil::register_tokens(action_context &ctx, const std::vector<token_spec> &tokens) {
+    const impl_contract_t impl = current_impl();
 
+    for (const auto &token : tokens) {
+        auto token_address_bytes = from_hex(token.token_address);
+        eosio::check(!!token_address_bytes, "token address must be valid 0x EVM address");
+        eosio::check(token_address_bytes->size() == kAddressLength, "invalid length of token address");
 
-    bytes call_data;
+        regtokenwithcodebytes(ctx, *token_address_bytes, impl.address, impl.id, token.dep_fee, token.erc20_precision);
+    }
+}
 
-    auto reserved_addr = silkworm::make_reserved_address(receiver_account().value);
-    initialize_data(call_data, solidity::rewardhelper::bytecode);
+void evmutil::dpystakeimpl() {
+    require_auth(get_self());
 
-    bytes to = {};
-    bytes value_zero;
-    value_zero.resize(32, 0);
+    action_context ctx = load_context();
+    deploy_stake_impl(ctx);
+}
 
-    uint64_t next_nonce = get_next_nonce();
+void evmutil::dpyrwdhelper() {
+    require_auth(get_self());
 
-    // required account opened in evm_runtime
-    config_t config = get_config();
-    evm_runtime::call_action call_act(config.evm_account, {{receiver_account(), "active"_n}});
-    call_act.send(receiver_account(), to, value_zero, call_data, config.evm_init_gaslimit);
+    action_context ctx = load_context();
+    deploy_reward_helper(ctx);
+    commit_context(ctx);
+}
 
-    evmc::address impl_addr = silkworm::create_address(reserved_addr, next_nonce);
+void evmutil::bootstrap(eosio::name evm_account, eosio::symbol gas_token_symbol, uint64_t gaslimit, uint64_t init_gaslimit,
+                        const std::optional<token_spec> &btc_deposit, const std::optional<token_spec> &xsat_deposit,
+                        const std::vector<token_spec> &tokens) {
+    require_auth(get_self());
 
-    helpers_t helpers = get_helpers();
-    helpers.reward_helper_address.resize(kAddressLength);
-    memcpy(&(helpers.reward_helper_address[0]), impl_addr.bytes, kAddressLength);
-    set_helpers(helpers);
+    eosio::check(!config_initialized(), "evmutil config already initialized");
+    token_table_t token_table(_self, _self.value);
+    token2_table_t token2_table(_self, _self.value);
+    eosio::check(token_table.begin() == token_table.end() && token2_table.begin() == token2_table.end(),
+                 "bootstrap requires a contract without registered tokens");
+
+    // Config and helpers only live in the context until the end, and every deployment shares its nonce.
+    action_context ctx;
+    ctx.config.evm_account = evm_account;
+    ctx.config.evm_gas_token_symbol = gas_token_symbol;
+    ctx.config.evm_gaslimit = gaslimit;
+    ctx.config.evm_init_gaslimit = init_gaslimit;
+    emplace_helper_extensions(ctx.helpers);
+    ctx.helpers_loaded = true;
+    ctx.mark_config();
+    ctx.mark_helpers();
+
+    deploy_stake_impl(ctx);
+    deploy_reward_helper(ctx);
+    deploy_gas_funds(ctx);
+    if (btc_deposit) deploy_deposit_helper(ctx, route_kind::btc_deposit, *btc_deposit);
+    if (xsat_deposit) deploy_deposit_helper(ctx, route_kind::xsat_deposit, *xsat_deposit);
+    register_tokens(ctx, tokens);
+
+    commit_context(ctx);
 }
 
 void evmutil::setrwdhelper(std::string impl_address) {
@@ -206,8 +545,10 @@ void evmutil::setrwdhelper(std::string impl_address) {
 
     helpers_t helpers = get_helpers();
 
+    erase_route(helpers.reward_helper_address);
     helpers.reward_helper_address.resize(kAddressLength);
     memcpy(&(helpers.reward_helper_address[0]), address_bytes->data(), kAddressLength);
+    set_route(helpers.reward_helper_address, route_kind::rewards, 0);
     set_helpers(helpers);
 }
 
@@ -217,158 +558,104 @@ void evmutil::setstakeimpl(std::string impl_address) {
     eosio::check(!!address_bytes, "implementation address must be valid 0x EVM address");
     eosio::check(address_bytes->size() == kAddressLength, "invalid length of implementation address");
 
-    uint64_t id = 0;
-    impl_contract_table_t contract_table(_self, _self.value);
-
-    contract_table.emplace(_self, [&](auto &v) {
-        v.id = contract_table.available_primary_key();
-        v.address.resize(kAddressLength);
-        memcpy(&(v.address[0]), address_bytes->data(), kAddressLength);
-    });
+    add_impl(*address_bytes);
 }
 
 void evmutil::dpyvlddepbtc(std::string token_address, const eosio::asset &dep_fee, uint8_t erc20_precision) {
     require_auth(get_self());
 
-    helpers_t helpers = get_helpers();
-    eosio::check(!helpers.btc_deposit_address || helpers.btc_deposit_address.value().empty(), "cannot deploy again");
-
-    impl_contract_table_t contract_table(_self, _self.value);
-    eosio::check(contract_table.begin() != contract_table.end(), "no implementaion contract available");
-    auto contract_itr = contract_table.end();
-    --contract_itr;
-
-    auto token_address_bytes = from_hex(token_address);
-    eosio::check(!!token_address_bytes, "token address must be valid 0x EVM address");
-    eosio::check(token_address_bytes->size() == kAddressLength, "invalid length of token address");
-
-    bytes proxy_contract_addr = deploy_stake_helper_proxy(*token_address_bytes, contract_itr->address, dep_fee, erc20_precision, false, true);
-
-
-    helpers.btc_deposit_address = proxy_contract_addr;
-    set_helpers(helpers);
+    action_context ctx = load_context();
+    deploy_deposit_helper(ctx, route_kind::btc_deposit, token_spec{token_address, dep_fee, erc20_precision});
+    commit_context(ctx);
 }
 
 void evmutil::dpyvlddepsat(std::string token_address, const eosio::asset &dep_fee, uint8_t erc20_precision) {
     require_auth(get_self());
 
-    helpers_t helpers = get_helpers();
-
-    eosio::check(!helpers.xsat_deposit_address || helpers.xsat_deposit_address.value().empty(), "cannot deploy again");
-
-    impl_contract_table_t contract_table(_self, _self.value);
-    eosio::check(contract_table.begin() != contract_table.end(), "no implementaion contract available");
-    auto contract_itr = contract_table.end();
-    --contract_itr;
-
-    auto token_address_bytes = from_hex(token_address);
-    eosio::check(!!token_address_bytes, "token address must be valid 0x EVM address");
-    eosio::check(token_address_bytes->size() == kAddressLength, "invalid length of token address");
-
-    bytes proxy_contract_addr = deploy_stake_helper_proxy(*token_address_bytes, contract_itr->address, dep_fee, erc20_precision, true, true);
-
-    helpers.xsat_deposit_address = proxy_contract_addr;
-    set_helpers(helpers);
+    action_context ctx = load_context();
+    deploy_deposit_helper(ctx, route_kind::xsat_deposit, token_spec{token_address, dep_fee, erc20_precision});
+    commit_context(ctx);
 }
 
-bytes evmutil::deploy_stake_helper_proxy(const bytes& erc20_address_bytes, const bytes& impl_address_bytes, const eosio::asset& dep_fee, uint8_t erc20_precision, bool notBTC, bool isValidatorDeposits) {
+bytes evmutil::deploy_stake_helper_proxy(action_context &ctx, route_kind kind, const bytes& erc20_address_bytes, const bytes& impl_address_bytes, const eosio::asset& dep_fee, uint8_t erc20_precision) {
+    const config_t &config = ctx.config;
     eosio::check(impl_address_bytes.size() == kAddressLength, "invalid length of implementation address");
 
-    config_t config = get_config();
-
     // 2^(256-64) = 6.2e+57, so the precision diff is at most 57
     eosio::check(erc20_precision >= dep_fee.symbol.precision() &&
     erc20_precision <= dep_fee.symbol.precision() + 57, "evmutil precision out of range");
 
     eosio::check(dep_fee.symbol == config.evm_gas_token_symbol, "deposit_fee should have native token symbol");
-    intx::uint256 dep_fee_evm = dep_fee.amount;
-    dep_fee_evm *= get_minimum_natively_representable(config);
-
-    auto reserved_addr = silkworm::make_reserved_address(receiver_account().value);
-    auto evm_reserved_addr = silkworm::make_reserved_address(config.evm_account.value);
-
-    bytes call_data;
-    initialize_data(call_data, solidity::proxy::bytecode);
-
-    // constructor(address evmutil_impl_contract, memory _data)
-    call_data.insert(call_data.end(), 32 - kAddressLength, 0);  // padding for address
-    call_data.insert(call_data.end(), impl_address_bytes.begin(), impl_address_bytes.end());
-
-    bytes constructor_data;
-    // initialize(address,address,address,uint256,bool,bool) => 1d1e7e92
-    uint8_t func_[4] = {0x1d,0x1e,0x7e,0x92};
-    constructor_data.insert(constructor_data.end(), func_, func_ + sizeof(func_));
-
-    auto pack_uint256 = [&](bytes &ds, const intx::uint256 &val) {
-        uint8_t val_[32] = {};
-        intx::be::store(val_, val);
-        ds.insert(ds.end(), val_, val_ + sizeof(val_));
-    };
-    auto pack_uint32 = [&](bytes &ds, uint32_t val) {
-        uint8_t val_[32] = {};
-        val_[28] = (uint8_t)(val >> 24);
-        val_[29] = (uint8_t)(val >> 16);
-        val_[30] = (uint8_t)(val >> 8);
-        val_[31] = (uint8_t)val;
-        ds.insert(ds.end(), val_, val_ + sizeof(val_));
-    };
-    auto pack_string = [&](bytes &ds, const auto &str) {
-        pack_uint32(ds, (uint32_t)str.size());
-        for (size_t i = 0; i < (str.size() + 31) / 32 * 32; i += 32) {
-            uint8_t name_[32] = {};
-            memcpy(name_, str.data() + i, i + 32 > str.size() ? str.size() - i : 32);
-            ds.insert(ds.end(), name_, name_ + sizeof(name_));
-        }
-    };
-
-    constructor_data.insert(constructor_data.end(), 32 - kAddressLength, 0);  // padding for address
-    constructor_data.insert(constructor_data.end(), reserved_addr.bytes, reserved_addr.bytes + kAddressLength);
-    constructor_data.insert(constructor_data.end(), 32 - kAddressLength, 0);  // padding for address
-    constructor_data.insert(constructor_data.end(), evm_reserved_addr.bytes, evm_reserved_addr.bytes + kAddressLength);
-    constructor_data.insert(constructor_data.end(), 32 - kAddressLength, 0);  // padding for address
-    constructor_data.insert(constructor_data.end(), erc20_address_bytes.begin(), erc20_address_bytes.end());
-
-    pack_uint256(constructor_data, dep_fee_evm);          // offset 32
-
-    pack_uint256(constructor_data, notBTC?1:0);   // notBTC
-    pack_uint256(constructor_data, isValidatorDeposits?1:0);   // isValidatorDeposits
-
-    pack_uint32(call_data, 64);                  // offset 32
-    pack_string(call_data, constructor_data);    // offset 64
-
-    bytes to = {};
-    bytes value_zero;
-    value_zero.resize(32, 0);
-
-    uint64_t next_nonce = get_next_nonce();
-
-    // required account opened in evm_runtime
-    evm_runtime::call_action call_act(config.evm_account, {{receiver_account(), "active"_n}});
-    call_act.send(receiver_account(), to, value_zero, call_data, config.evm_init_gaslimit);
-
-    evmc::address proxy_contract_addr = silkworm::create_address(reserved_addr, next_nonce);
-    bytes result;
-    result.resize(kAddressLength, 0);
-    memcpy(&(result[0]), proxy_contract_addr.bytes, kAddressLength);
-    return result;
+    eosio::check(dep_fee.amount >= 0, "deposit_fee must not be negative");
+    intx::uint256 dep_fee_evm = to_evm_amount(dep_fee.amount, gas_token_scale(config.evm_gas_token_symbol));
+
+    const bool notBTC = kind == route_kind::xsat_deposit;
+    const bool isValidatorDeposits = kind == route_kind::btc_deposit || kind == route_kind::xsat_deposit;
+
+    auto reserved_addr = make_reserved_address(receiver_account().value);
+    auto evm_reserved_addr = make_reserved_address(config.evm_account.value);
+
+    // All proxies take constructor(address, bytes memory _data), with _data the initialize() call of the stake helper.
+    // The address is the implementation, or the beacon for beacon proxies.
+    eosio::name proxy_kind = code_kind::proxy;
+    bytes logic_address = impl_address_bytes;
+    switch (config.get_proxy_mode()) {
+    case proxy_mode::erc1967:
+        break;
+    case proxy_mode::minimal:
+        proxy_kind = code_kind::minimal_proxy;
+        break;
+    case proxy_mode::beacon:
+        eosio::check(ctx.helpers.beacon_address.has_value() && !ctx.helpers.beacon_address.value().empty(), "stake helper beacon not deployed");
+        proxy_kind = code_kind::beacon_proxy;
+        logic_address = ctx.helpers.beacon_address.value();
+        break;
+    default:
+        eosio::check(false, "invalid proxy mode");
+    }
+    const bytecode_t proxy_code = find_code(proxy_kind);
+
+    constexpr size_t init_size = 4 + 6 * 32;
+    const size_t code_size = proxy_code.size + 3 * 32 + abi_encoder::padded(init_size);
+
+    return deploy_contract(ctx, code_size, make_deploy_salt(deploy_tag::stake_proxy, uint8_t(kind), erc20_address_bytes), [&](abi_encoder &code) {
+        write_code(code, proxy_kind, proxy_code);
+        code.address(logic_address)
+            .word(64);                                         // offset of _data
+
+        size_t init_begin = code.begin_bytes(init_size);
+        code.selector(evm_calls::stake_helper_initialize)
+            .address(reserved_addr.data())                       // _linkedEOSAddress
+            .address(evm_reserved_addr.data())                   // _evmAddress
+            .address(erc20_address_bytes)                       // _linkedERC20
+            .word(dep_fee_evm)                                  // _depositFee
+            .boolean(notBTC)                                    // _notBTC
+            .boolean(isValidatorDeposits)                       // _isValidatorDeposits
+            .end_bytes(init_begin);
+    });
 }
 
-void evmutil::regtokenwithcodebytes(const bytes& erc20_address_bytes, const bytes& impl_address_bytes, const eosio::asset& dep_fee, uint8_t erc20_precision) {
+void evmutil::regtokenwithcodebytes(action_context &ctx, const bytes& erc20_address_bytes, const bytes& impl_address_bytes, std::optional<uint64_t> impl_id, const eosio::asset& dep_fee, uint8_t erc20_precision) {
     require_auth(get_self());
+    check_tokens_migrated();
 
-    token_table_t token_table(_self, _self.value);
+    const checksum160 token_key = make_key160(byte_span(erc20_address_bytes));
+    token2_table_t token_table(_self, _self.value);
     auto index_symbol = token_table.get_index<"by.tokenaddr"_n>();
-    check(index_symbol.find(make_key(erc20_address_bytes)) == index_symbol.end(), "token already registered");
+    check(find_token(index_symbol, &token2_t::token_address, token_key) == index_symbol.end(), "token already registered");
 
-    bytes proxy_contract_addr = deploy_stake_helper_proxy(erc20_address_bytes, impl_address_bytes, dep_fee, erc20_precision, false, false);
+    const uint8_t delta_precision = get_delta_precision(ctx.config, erc20_precision);
+    bytes proxy_contract_addr = deploy_stake_helper_proxy(ctx, route_kind::erc20_stake, erc20_address_bytes, impl_address_bytes, dep_fee, erc20_precision);
+    set_route(proxy_contract_addr, route_kind::erc20_stake, delta_precision);
+    const proxy_mode mode = ctx.config.get_proxy_mode();
+    set_proxy_impl(proxy_contract_addr, mode == proxy_mode::beacon ? std::nullopt : impl_id, mode);
 
     token_table.emplace(_self, [&](auto &v) {
         v.id = token_table.available_primary_key();
-        v.address.resize(kAddressLength, 0);
-        memcpy(&(v.address[0]), proxy_contract_addr.data(), kAddressLength);
+        v.address = make_key160(byte_span(proxy_contract_addr));
+        v.token_address = token_key;
         v.erc20_precision = erc20_precision;
-        v.token_address.resize(kAddressLength, 0);
-        memcpy(&(v.token_address[0]), erc20_address_bytes.data(), kAddressLength);
+        v.multiplier = precision_scale::of(delta_precision).multiplier;
     });
 }
 
@@ -382,22 +669,31 @@ void evmutil::regwithcode(std::string token_address, std::string impl_address, c
     eosio::check(!!token_address_bytes, "token address must be valid 0x EVM address");
     eosio::check(token_address_bytes->size() == kAddressLength, "invalid length of token address");
 
-    regtokenwithcodebytes(*token_address_bytes, *address_bytes, dep_fee, erc20_precision);
+    // The implementation given here is not necessarily registered, so it is not tracked.
+    action_context ctx = load_context();
+    regtokenwithcodebytes(ctx, *token_address_bytes, *address_bytes, std::nullopt, dep_fee, erc20_precision);
 }
 
 void evmutil::regtoken(std::string token_address, const eosio::asset &dep_fee, uint8_t erc20_precision) {
     require_auth(get_self());
 
-    impl_contract_table_t contract_table(_self, _self.value);
-    eosio::check(contract_table.begin() != contract_table.end(), "no implementaion contract available");
-    auto contract_itr = contract_table.end();
-    --contract_itr;
+    const impl_contract_t impl = current_impl();
 
     auto token_address_bytes = from_hex(token_address);
     eosio::check(!!token_address_bytes, "token address must be valid 0x EVM address");
     eosio::check(token_address_bytes->size() == kAddressLength, "invalid length of token address");
 
-    regtokenwithcodebytes(*token_address_bytes, contract_itr->address, dep_fee, erc20_precision);
+    action_context ctx = load_context();
+    regtokenwithcodebytes(ctx, *token_address_bytes, impl.address, impl.id, dep_fee, erc20_precision);
+}
+
+void evmutil::regtokens(const std::vector<token_spec> &tokens) {
+    require_auth(get_self());
+    eosio::check(!tokens.empty(), "no token to register");
+
+    // One context for the whole batch, so the nonce is asserted once and every proxy gets its own address.
+    action_context ctx = load_context();
+    register_tokens(ctx, tokens);
 }
 
 void evmutil::unregtoken(std::string proxy_address) {
@@ -407,246 +703,478 @@ void evmutil::unregtoken(std::string proxy_address) {
     eosio::check(!!proxy_address_bytes, "token address must be valid 0x EVM address");
     eosio::check(proxy_address_bytes->size() == kAddressLength, "invalid length of token address");
 
-    token_table_t token_table(_self, _self.value);
+    check_tokens_migrated();
+
+    token2_table_t token_table(_self, _self.value);
     auto index_symbol = token_table.get_index<"by.tokenaddr"_n>();
-    auto token_table_iter = index_symbol.find(make_key(*proxy_address_bytes));
+    auto token_table_iter = find_token(index_symbol, &token2_t::token_address, make_key160(byte_span(*proxy_address_bytes)));
     eosio::check(token_table_iter != index_symbol.end(), "token not registered");
 
+    erase_route(key160_bytes(token_table_iter->address));
     index_symbol.erase(token_table_iter);
 }
 
-void evmutil::handle_endorser_stakes(const bridge_message_v0 &msg, uint64_t delta_precision, bool is_deposit, bool is_xsat) {
-
-    check(msg.data.size() >= 4, "not enough data in bridge_message_v0");
-    config_t config = get_config();
-
-    uint32_t app_type = 0;
-    memcpy((void *)&app_type, (const void *)&(msg.data[0]), sizeof(app_type));
-    // 0xdc4653f4 : f45346dc : deposit(address,uint256,address)
-    // 0xec8d3269 : 69328dec : withdraw(address,uint256,address)
-    // 0x42b3c021 : 21c0b342 : claim(address,address)
-    // 0x2b7d501d : 1d507d2b : restake(address,address,address)
-    // 0xac2fd4fc : fcd42fac : claim2(address,address,uint256)
+void evmutil::handle_endorser_stakes(action_context &ctx, const bridge_message_view &msg) {
+    static constexpr dispatch_entry<message_handler_t> entries[] = {
+        bind_view<calls::stake_deposit, &evmutil::handle_stake_deposit>(),
+        bind_view<calls::stake_withdraw, &evmutil::handle_stake_withdraw>(),
+        bind_view<calls::stake_claim, &evmutil::handle_stake_claim>(),
+        bind_view<calls::stake_claim2, &evmutil::handle_stake_claim2>(),
+        bind_view<calls::stake_restake, &evmutil::handle_stake_restake>(),
+        bind_view<calls::stake_transfer, &evmutil::handle_stake_transfer>(),
+        bind_view<calls::stake_batch, &evmutil::handle_stake_batch>(),
+    };
+    static constexpr auto handlers = make_dispatch_table(entries);
+    static_assert(handlers.unique(), "duplicated selector in stake handlers");
 
-    if (app_type == 0x42b3c021) /* claim(address,address) */{
-        check(msg.data.size() >= 4 + 32 /*to*/ + 32 /*from*/,
-            "not enough data in bridge_message_v0 of application type 0x653332e5");
+    const auto &entry = handlers.route(msg.data);
+    (this->*entry.handler)(ctx, msg);
+}
 
-        uint64_t dest_acc;
-        readExSatAccount(msg.data, 4, dest_acc);
+void evmutil::handle_stake_claim(action_context &ctx, const bridge_message_view &msg, const abi_view<calls::stake_claim> &args) {
+    // Use same claim
+    send_claim(ctx, make_key160(msg.sender), args.get_address<1>(), args.get_account<0>());
+}
 
-        evmc::address sender_addr;
-        readEvmAddress(msg.data, 4 + 32, sender_addr);
+void evmutil::handle_stake_claim2(action_context &ctx, const bridge_message_view &msg, const abi_view<calls::stake_claim2> &args) {
+    uint64_t dest_acc = args.get_account<0>();
+    checksum160 sender_addr = args.get_address<1>();
 
-        // Use same claim
-        endrmng::evmclaim_action evmclaim_act(config.endrmng_account, {{receiver_account(), "active"_n}});
-        evmclaim_act.send(get_self(), make_key160(msg.sender), make_key160(sender_addr.bytes, kAddressLength), dest_acc);
-    } else if (app_type == 0xac2fd4fc) /* claim2(address,address,uint256) */{
-        check(msg.data.size() >= 4 + 32 /*to*/ + 32 /*from*/ + 32 /*donate_rate*/,
-            "not enough data in bridge_message_v0 of application type 0xac2fd4fc");
+    intx::uint256 value = args.get_uint<2>();
+    check(value <= 10000, "donate rate must smaller than 10000");
 
-        uint64_t dest_acc;
-        readExSatAccount(msg.data, 4, dest_acc);
+    send_claim2(ctx, make_key160(msg.sender), sender_addr, dest_acc, (uint16_t)value);
+}
 
-        evmc::address sender_addr;
-        readEvmAddress(msg.data, 4 + 32, sender_addr);
+void evmutil::handle_stake_deposit(action_context &ctx, const bridge_message_view &msg, const abi_view<calls::stake_deposit> &args) {
+    uint64_t dest_acc = args.get_account<0>();
+    uint64_t dest_amount = args.get_amount<1>(ctx.route.scale);
+    checksum160 sender_addr = args.get_address<2>();
 
-        intx::uint256 value;
-        readUint256(msg.data, 4 + 32 + 32, value);
+    send_stake(ctx, make_key160(msg.sender), sender_addr, dest_acc, dest_amount);
+}
 
-        check(value <= 10000, "donate rate must smaller than 10000");
+void evmutil::handle_stake_withdraw(action_context &ctx, const bridge_message_view &msg, const abi_view<calls::stake_withdraw> &args) {
+    uint64_t dest_acc = args.get_account<0>();
+    uint64_t dest_amount = args.get_amount<1>(ctx.route.scale);
+    checksum160 sender_addr = args.get_address<2>();
 
-        uint16_t donate_rate = (uint16_t)value;
+    send_unstake(ctx, make_key160(msg.sender), sender_addr, dest_acc, dest_amount);
+}
 
-        endrmng::evmclaim2_action evmclaim2_act(config.endrmng_account, {{receiver_account(), "active"_n}});
-        evmclaim2_act.send(get_self(), make_key160(msg.sender), make_key160(sender_addr.bytes, kAddressLength), dest_acc, donate_rate);
-    } else if (app_type == 0xdc4653f4) /* deposit(address,uint256,address) */{
-        check(msg.data.size() >= 4 + 32 + 32 + 32,
-            "not enough data in bridge_message_v0 of application type 0xdc4653f4");
+void evmutil::handle_stake_restake(action_context &ctx, const bridge_message_view &msg, const abi_view<calls::stake_restake> &args) {
+    uint64_t from_acc = args.get_account<0>();
+    uint64_t to_acc = args.get_account<1>();
+    uint64_t dest_amount = args.get_amount<2>(ctx.route.scale);
+    checksum160 sender_addr = args.get_address<3>();
 
-        uint64_t dest_acc;
-        readExSatAccount(msg.data, 4, dest_acc);
+    send_restake(ctx, make_key160(msg.sender), sender_addr, from_acc, to_acc, dest_amount);
+}
 
-        uint64_t dest_amount = 0;
-        readTokenAmount(msg.data, 4 + 32, dest_amount, delta_precision);
+// transfer(address from_validator, address to_validator, uint256 amount, address from_staker, address to_staker)
+// Moves authorized stake from a user to an operator, in one endrmng action once setstaketrf enabled it.
+void evmutil::handle_stake_transfer(action_context &ctx, const bridge_message_view &msg, const abi_view<calls::stake_transfer> &args) {
+    uint64_t from_acc = args.get_account<0>();
+    uint64_t to_acc = args.get_account<1>();
+    uint64_t dest_amount = args.get_amount<2>(ctx.route.scale);
+    checksum160 from_staker = args.get_address<3>();
+    checksum160 to_staker = args.get_address<4>();
+
+    // StakeHelper forbids transfers on the validator deposit helpers.
+    eosio::check(!ctx.route.is_xsat && !ctx.route.is_deposit, "invalid operation");
+
+    const checksum160 proxy = make_key160(msg.sender);
+
+    stake_config_singleton_t stake_config(_self, _self.value);
+    if (!stake_config.exists() || !stake_config.get().single_transfer) {
+        send_unstake(ctx, proxy, from_staker, from_acc, dest_amount);
+        send_stake(ctx, proxy, to_staker, to_acc, dest_amount);
+        return;
+    }
 
-        evmc::address sender_addr;
-        readEvmAddress(msg.data, 4 + 32 + 32, sender_addr);
+    endrmng::evmtransfer_action evmtransfer_act(ctx.state.endrmng(), {{receiver_account(), "active"_n}});
+    ctx.emit(evmtransfer_act.to_action(get_self(), proxy, from_staker, to_staker, from_acc, to_acc, eosio::asset(dest_amount, ctx.state.gas_token())));
+}
 
-        if (is_xsat) {
-            endrmng::evmstakexsat_action evmstakexsat_act(config.endrmng_account, {{receiver_account(), "active"_n}});
-            evmstakexsat_act.send(get_self(), make_key160(msg.sender),make_key160(sender_addr.bytes, kAddressLength), dest_acc, eosio::asset(dest_amount, default_xsat_token_symbol));
+// batch(address staker, (uint8 kind, address from, address target, uint256 amount)[] ops)
+// Decodes every operation of the array and sends one endrmng action per operation.
+void evmutil::handle_stake_batch(action_context &ctx, const bridge_message_view &msg, const abi_view<calls::stake_batch> &args) {
+    const checksum160 proxy = make_key160(msg.sender);
+    const checksum160 staker = args.get_address<0>();
+
+    const auto ops = args.get_array<1, calls::stake_batch_op>(max_batch_ops);
+    check(ops.size() > 0, "invalid number of batch operations");
+
+    for (size_t i = 0; i < ops.size(); ++i) {
+        const auto op = ops[i];
+
+        intx::uint256 kind = op.get_uint<0>();
+        check(kind <= uint8_t(stake_op::claim2), "unsupported batch operation");
+
+        switch (stake_op(uint8_t(kind))) {
+        case stake_op::deposit:
+            send_stake(ctx, proxy, staker, op.get_account<2>(), op.get_amount<3>(ctx.route.scale));
+            break;
+        case stake_op::withdraw:
+            send_unstake(ctx, proxy, staker, op.get_account<2>(), op.get_amount<3>(ctx.route.scale));
+            break;
+        case stake_op::restake:
+            send_restake(ctx, proxy, staker, op.get_account<1>(), op.get_account<2>(), op.get_amount<3>(ctx.route.scale));
+            break;
+        case stake_op::claim:
+            send_claim(ctx, proxy, staker, op.get_account<2>());
+            break;
+        case stake_op::claim2: {
+            // The amount word carries the donate rate for claim2.
+            intx::uint256 donate_rate = op.get_uint<3>();
+            check(donate_rate <= 10000, "donate rate must smaller than 10000");
+            send_claim2(ctx, proxy, staker, op.get_account<2>(), (uint16_t)donate_rate);
+            break;
         }
-        else {
-            endrmng::evmstake_action evmstake_act(config.endrmng_account, {{receiver_account(), "active"_n}});
-            evmstake_act.send(get_self(), make_key160(msg.sender),make_key160(sender_addr.bytes, kAddressLength), dest_acc, eosio::asset(dest_amount, config.evm_gas_token_symbol));
         }
+    }
+}
 
-    } else if (app_type == 0xec8d3269) /* withdraw(address,uint256,address) */ {
-        check(msg.data.size() >= 4 + 32 + 32 + 32,
-            "not enough data in bridge_message_v0 of application type 0xec8d3269");
+void evmutil::send_stake(const action_context &ctx, const checksum160 &proxy, const checksum160 &staker, uint64_t validator, uint64_t amount) {
+    if (ctx.route.is_xsat) {
+        endrmng::evmstakexsat_action evmstakexsat_act(ctx.state.endrmng(), {{receiver_account(), "active"_n}});
+        ctx.emit(evmstakexsat_act.to_action(get_self(), proxy, staker, validator, eosio::asset(amount, default_xsat_token_symbol)));
+    }
+    else {
+        endrmng::evmstake_action evmstake_act(ctx.state.endrmng(), {{receiver_account(), "active"_n}});
+        ctx.emit(evmstake_act.to_action(get_self(), proxy, staker, validator, eosio::asset(amount, ctx.state.gas_token())));
+    }
+}
 
-        uint64_t dest_acc;
-        readExSatAccount(msg.data, 4, dest_acc);
+void evmutil::send_unstake(const action_context &ctx, const checksum160 &proxy, const checksum160 &staker, uint64_t validator, uint64_t amount) {
+    if (ctx.route.is_xsat) {
+        endrmng::evmunstkxsat_action evmunstkxsat_act(ctx.state.endrmng(), {{receiver_account(), "active"_n}});
+        ctx.emit(evmunstkxsat_act.to_action(get_self(), proxy, staker, validator, eosio::asset(amount, default_xsat_token_symbol)));
+    }
+    else {
+        endrmng::evmunstake_action evmunstake_act(ctx.state.endrmng(), {{receiver_account(), "active"_n}});
+        ctx.emit(evmunstake_act.to_action(get_self(), proxy, staker, validator, eosio::asset(amount, ctx.state.gas_token())));
+    }
+}
 
-        uint64_t dest_amount = 0;
-        readTokenAmount(msg.data, 4 + 32, dest_amount, delta_precision);
+void evmutil::send_restake(const action_context &ctx, const checksum160 &proxy, const checksum160 &staker, uint64_t from_validator, uint64_t to_validator, uint64_t amount) {
+    if (ctx.route.is_xsat || ctx.route.is_deposit) {
+        // There's no valid routine to reach here by current design.
+        // Assert here for extra protection.
+        eosio::check(false, "invalid operation");
+    }
+    else {
+        endrmng::evmnewstake_action evmnewstake_act(ctx.state.endrmng(), {{receiver_account(), "active"_n}});
+        ctx.emit(evmnewstake_act.to_action(get_self(), proxy, staker, from_validator, to_validator, eosio::asset(amount, ctx.state.gas_token())));
+    }
+}
 
-        evmc::address sender_addr;
-        readEvmAddress(msg.data, 4 + 32 + 32, sender_addr);
+void evmutil::send_claim(const action_context &ctx, const checksum160 &proxy, const checksum160 &staker, uint64_t validator) {
+    if (!first_claim_in_block(ctx, claim_kind::endorser, proxy, staker, validator)) return;
+    endrmng::evmclaim_action evmclaim_act(ctx.state.endrmng(), {{receiver_account(), "active"_n}});
+    ctx.emit(evmclaim_act.to_action(get_self(), proxy, staker, validator));
+}
 
-        if (is_xsat) {
-            endrmng::evmunstkxsat_action evmunstkxsat_act(config.endrmng_account, {{receiver_account(), "active"_n}});
-            evmunstkxsat_act.send(get_self(), make_key160(msg.sender), make_key160(sender_addr.bytes, kAddressLength), dest_acc, eosio::asset(dest_amount, default_xsat_token_symbol));
-        }
-        else {
-            endrmng::evmunstake_action evmunstake_act(config.endrmng_account, {{receiver_account(), "active"_n}});
-            evmunstake_act.send(get_self(), make_key160(msg.sender), make_key160(sender_addr.bytes, kAddressLength), dest_acc, eosio::asset(dest_amount, config.evm_gas_token_symbol));
-        }
-    } else if (app_type == 0x2b7d501d) /* restake(address,address,uint256,address) */{
-        check(msg.data.size() >= 4 + 32 + 32 + 32 + 32,
-            "not enough data in bridge_message_v0 of application type 0x97fba943");
+void evmutil::send_claim2(const action_context &ctx, const checksum160 &proxy, const checksum160 &staker, uint64_t validator, uint16_t donate_rate) {
+    if (!first_claim_in_block(ctx, claim_kind::endorser_share, proxy, staker, validator, donate_rate)) return;
+    endrmng::evmclaim2_action evmclaim2_act(ctx.state.endrmng(), {{receiver_account(), "active"_n}});
+    ctx.emit(evmclaim2_act.to_action(get_self(), proxy, staker, validator, donate_rate));
+}
 
-        uint64_t from_acc;
-        readExSatAccount(msg.data, 4, from_acc);
+bool evmutil::first_claim_in_block(const action_context &ctx, claim_kind kind, const checksum160 &proxy, const checksum160 &staker, uint64_t target, uint16_t variant) {
+    // Dry runs report every claim and leave the log alone, or a queued claim would skip itself when processed.
+    if (ctx.simulated || !ctx.sender_route) return true;
+
+    claim_config_singleton_t claim_config(_self, _self.value);
+    if (!claim_config.exists() || !claim_config.get().coalesced(ctx.sender_route->get_kind())) return true;
+
+    uint8_t buf[1 + 2 * kAddressLength + sizeof(target) + sizeof(variant)];
+    buf[0] = uint8_t(kind);
+    const auto proxy_raw = proxy.extract_as_byte_array();
+    const auto staker_raw = staker.extract_as_byte_array();
+    memcpy(buf + 1, proxy_raw.data(), kAddressLength);
+    memcpy(buf + 1 + kAddressLength, staker_raw.data(), kAddressLength);
+    memcpy(buf + 1 + 2 * kAddressLength, &target, sizeof(target));
+    memcpy(buf + 1 + 2 * kAddressLength + sizeof(target), &variant, sizeof(variant));
+
+    const auto digest = eosio::sha256((const char *)buf, sizeof(buf)).extract_as_byte_array();
+    uint64_t slot = 0, tag = 0;
+    memcpy(&slot, digest.data(), sizeof(slot));
+    memcpy(&tag, digest.data() + sizeof(slot), sizeof(tag));
+    slot %= claim_log_slots;
+
+    const uint32_t block_num = eosio::current_block_number();
+    claim_log_table_t log(_self, _self.value);
+    auto itr = log.find(slot);
+    if (itr == log.end()) {
+        log.emplace(_self, [&](auto &v) {
+            v.slot = slot;
+            v.tag = tag;
+            v.block_num = block_num;
+        });
+        return true;
+    }
+    if (itr->tag == tag && itr->block_num == block_num) return false;
 
-        uint64_t to_acc;
-        readExSatAccount(msg.data, 4 + 32, to_acc);
+    log.modify(itr, eosio::same_payer, [&](auto &v) {
+        v.tag = tag;
+        v.block_num = block_num;
+    });
+    return true;
+}
 
-        uint64_t dest_amount = 0;
-        readTokenAmount(msg.data, 4 + 32 + 32, dest_amount, delta_precision);
+void evmutil::handle_utxo_access(const bridge_message_view &msg) {
 
-        evmc::address sender_addr;
-        readEvmAddress(msg.data, 4 + 32 + 32 + 32, sender_addr);
+}
 
-        if (is_xsat || is_deposit ) {
-            // There's no valid routine to reach here by current design.
-            // Assert here for extra protection.
-            eosio::check(false, "invalid operation");
-        }
-        else {
-            endrmng::evmnewstake_action evmnewstake_act(config.endrmng_account, {{receiver_account(), "active"_n}});
-            evmnewstake_act.send(get_self(), make_key160(msg.sender),make_key160(sender_addr.bytes, kAddressLength), from_acc, to_acc, eosio::asset(dest_amount, config.evm_gas_token_symbol));
-        }
-    } else {
-        eosio::check(false, "unsupported bridge_message version");
-    }
+void evmutil::handle_rewards(action_context &ctx, const bridge_message_view &msg) {
+    static constexpr dispatch_entry<message_handler_t> entries[] = {
+        bind_view<calls::reward_claim, &evmutil::handle_reward_claim>(),
+        bind_view<calls::reward_vdrclaim, &evmutil::handle_reward_vdrclaim>(),
+        bind_view<calls::reward_creditclaim, &evmutil::handle_reward_creditclaim>(),
+    };
+    static constexpr auto handlers = make_dispatch_table(entries);
+    static_assert(handlers.unique(), "duplicated selector in reward handlers");
+
+    const auto &entry = handlers.route(msg.data);
+    (this->*entry.handler)(ctx, msg);
 }
 
-void evmutil::handle_utxo_access(const bridge_message_v0 &msg) {
+void evmutil::handle_reward_claim(action_context &ctx, const bridge_message_view &msg, const abi_view<calls::reward_claim> &args) {
+    uint64_t dest_acc = args.get_account<0>();
+
+    // Note that there's a second argument in the call for the sender address.
+    // We currently do not use it. But we collect in the bridge call in case we want to add more sanity checks here.
 
+    if (!first_claim_in_block(ctx, claim_kind::synchronizer, checksum160(), checksum160(), dest_acc)) return;
+
+    poolreg::claim_action claim_act(ctx.state.poolreg(), {{receiver_account(), "active"_n}});
+    // seems hit some bug/limitation in the template, need an explicit conversion here.
+    ctx.emit(claim_act.to_action(eosio::name(dest_acc)));
 }
 
-void evmutil::handle_rewards(const bridge_message_v0 &msg) {
-    config_t config = get_config();
-    check(msg.data.size() >= 4, "not enough data in bridge_message_v0");
+void evmutil::handle_reward_vdrclaim(action_context &ctx, const bridge_message_view &msg, const abi_view<calls::reward_vdrclaim> &args) {
+    uint64_t dest_acc = args.get_account<0>();
+
+    // Note that there's a second argument in the call for the sender address.
+    // We currently do not use it. But we collect in the bridge call in case we want to add more sanity checks here.
+
+    if (!first_claim_in_block(ctx, claim_kind::validator, checksum160(), checksum160(), dest_acc)) return;
+
+    endrmng::vdrclaim_action vdrclaim_act(ctx.state.endrmng(), {{receiver_account(), "active"_n}});
+    // seems hit some bug/limitation in the template, need an explicit conversion here.
+    ctx.emit(vdrclaim_act.to_action(eosio::name(dest_acc)));
+}
+
+void evmutil::handle_reward_creditclaim(action_context &ctx, const bridge_message_view &msg, const abi_view<calls::reward_creditclaim> &args) {
+    uint64_t dest_acc = args.get_account<0>();
+    checksum160 proxy_addr = args.get_address<1>();
+    checksum160 sender_addr = args.get_address<2>();
+
+    send_claim(ctx, proxy_addr, sender_addr, dest_acc);
+}
+
+void evmutil::transfer(eosio::name from, eosio::name to, eosio::asset quantity,
+                     std::string memo) {
+    if (to != get_self() || from == get_self()) return;
+    eosio::check(false, "this address should not accept tokens");
+}
+
+void evmutil::onbridgemsg(const bridge_message_t &message) {
+    // Normally unreachable: pre_dispatch() handles onbridgemsg without deserializing into vectors.
+    handle_bridge_message(bridge_message_view::from(std::get<bridge_message_v0>(message)));
+}
 
-    uint32_t app_type = 0;
-    memcpy((void *)&app_type, (const void *)&(msg.data[0]), sizeof(app_type));
+void evmutil::handle_bridge_message(const bridge_message_view &msg) {
+    // Senders are resolved through the route table alone, helpers are not needed here.
+    action_context ctx = load_message_context();
 
-    // 0x42b3c021 : 21c0b342 : claim(address,address)
-    // 0xc16fb607 : 07b66fc1 : vdrclaim(address,address)
-    // 0x3d7bb560 : 60b57b3d : creditclaim(address,address,address)
-    if (app_type == 0x42b3c021) {
-        check(msg.data.size() >= 4 + 32 /*to*/ + 32 /*from*/,
-            "not enough data in bridge_message_v0 of application type 0x653332e5");
+    check(get_sender() == ctx.state.evm(), "invalid sender of onbridgemsg");
 
-        uint64_t dest_acc;
-        readExSatAccount(msg.data, 4, dest_acc);
+    if (enqueue_bridge_message(ctx, msg)) return;
+    dispatch_bridge_message(ctx, msg);
+    commit_context(ctx);
+}
 
-        // Note that there's a second argument in the call for the sender address.
-        // We currently do not use it. But we collect in the bridge call in case we want to add more sanity checks here.
+bool evmutil::enqueue_bridge_message(action_context &ctx, const bridge_message_view &msg) {
+    if (msg.data.size() < 4) return false;
+
+    queue_config_singleton_t queue_config(_self, _self.value);
+    if (!queue_config.exists()) return false;
+    const queue_config_t calls = queue_config.get();
+    const uint32_t selector = read_selector(msg.data);
+    if (!calls.queued(selector)) return false;
+
+    // The selector is queued for some route kind, resolve the sender to see whether it is its own.
+    route_table_t routes(_self, _self.value);
+    auto itr = find_route(routes, msg.sender);
+    const std::optional<route_t> route = itr != routes.end() ? std::optional<route_t>(*itr) : find_legacy_route(ctx.state, msg.sender);
+    if (!route || !calls.queued(route->get_kind(), selector)) return false;
+
+    // Ids grow by one per message, so the id range bounds the number of rows. A full queue dispatches inline,
+    // which keeps the RAM paid by this contract bounded however often the message is sent.
+    queued_msg_table_t queue(_self, _self.value);
+    if (queue.begin() != queue.end() && queue.available_primary_key() - queue.begin()->id >= calls.max_length) return false;
+
+    // Decode now so a malformed message still fails the EVM transaction. The recorded actions are discarded.
+    std::vector<simulated_action> discarded;
+    ctx.simulated = &discarded;
+    dispatch_bridge_message(ctx, msg);
+    ctx.simulated = nullptr;
+
+    queue.emplace(_self, [&](auto &v) {
+        v.id = queue.available_primary_key();
+        v.sender = make_key160(msg.sender);
+        v.data.assign(msg.data.data(), msg.data.data() + msg.data.size());
+    });
+    return true;
+}
 
-        poolreg::claim_action claim_act(config.poolreg_account, {{receiver_account(), "active"_n}});
-        // seems hit some bug/limitation in the template, need an explicit conversion here.
-        claim_act.send(eosio::name(dest_acc));
-    } else if (app_type == 0xc16fb607) {
-        check(msg.data.size() >= 4 + 32 /*to*/ + 32 /*from*/,
-            "not enough data in bridge_message_v0 of application type 0x653332e5");
+std::vector<simulated_action> evmutil::simulate(const bridge_message_t &message) {
+    std::vector<simulated_action> result;
+    action_context ctx = load_message_context();
+    ctx.simulated = &result;
 
-        uint64_t dest_acc;
-        readExSatAccount(msg.data, 4, dest_acc);
+    dispatch_bridge_message(ctx, bridge_message_view::from(std::get<bridge_message_v0>(message)));
+    return result;
+}
 
-        // Note that there's a second argument in the call for the sender address.
-        // We currently do not use it. But we collect in the bridge call in case we want to add more sanity checks here.
+void evmutil::setqueued(uint8_t kind, uint32_t selector, bool queued) {
+    require_auth(get_self());
+    eosio::check(kind <= uint8_t(route_kind::erc20_stake), "unknown route kind");
+    eosio::check(is_queueable(selector), "only claim selectors can be queued");
 
-        endrmng::vdrclaim_action vdrclaim_act(config.endrmng_account, {{receiver_account(), "active"_n}});
-        // seems hit some bug/limitation in the template, need an explicit conversion here.
-        vdrclaim_act.send(eosio::name(dest_acc));
+    queue_config_singleton_t queue_config(_self, _self.value);
+    queue_config_t v = queue_config.get_or_default();
+    auto itr = std::find(v.calls.begin(), v.calls.end(), queued_call_t{kind, selector});
+    if (queued && itr == v.calls.end()) v.calls.push_back({kind, selector});
+    if (!queued && itr != v.calls.end()) v.calls.erase(itr);
 
+    if (v.calls.empty()) queue_config.remove();
+    else queue_config.set(v, _self);
+}
 
-    } else if (app_type == 0x3d7bb560) /* creditclaim(address,address,address) */{
-        check(msg.data.size() >= 4 + 32 /*to*/ + 32 /*proxy*/ + 32 /*from*/,
-            "not enough data in bridge_message_v0 of application type 0x653332e5");
+void evmutil::setqueuecap(uint32_t max_length) {
+    require_auth(get_self());
+    eosio::check(max_length > 0, "max_length must be positive");
 
-        uint64_t dest_acc;
-        readExSatAccount(msg.data, 4, dest_acc);
+    queue_config_singleton_t queue_config(_self, _self.value);
+    eosio::check(queue_config.exists(), "no queued calls");
+    queue_config_t v = queue_config.get();
+    v.max_length = max_length;
+    queue_config.set(v, _self);
+}
 
-        evmc::address proxy_addr;
-        readEvmAddress(msg.data, 4 + 32, proxy_addr);
+void evmutil::process(uint64_t start_id, uint32_t max) {
+    eosio::check(max > 0 && max <= max_queue_batch, "max out of range");
 
-        evmc::address sender_addr;
-        readEvmAddress(msg.data, 4 + 32 + 32, sender_addr);
+    queued_msg_table_t queue(_self, _self.value);
+    auto itr = queue.lower_bound(start_id);
+    eosio::check(itr != queue.end(), "message queue is empty");
 
-        endrmng::evmclaim_action evmclaim_act(config.endrmng_account, {{receiver_account(), "active"_n}});
-        evmclaim_act.send(get_self(), make_key160(proxy_addr.bytes, kAddressLength), make_key160(sender_addr.bytes, kAddressLength), dest_acc);
-    }
-    else {
-        eosio::check(false, "unsupported bridge_message version");
+    // Claims do not depend on each other, so messages after a failing one can go first.
+    action_context ctx = load_message_context();
+    for (uint32_t count = 0; count < max && itr != queue.end(); ++count) {
+        const bytes sender = key160_bytes(itr->sender);
+        dispatch_bridge_message(ctx, {receiver_account(), sender, eosio::time_point(), byte_span(), itr->data});
+        itr = queue.erase(itr);
     }
+    commit_context(ctx);
 }
 
-void evmutil::transfer(eosio::name from, eosio::name to, eosio::asset quantity,
-                     std::string memo) {
-    if (to != get_self() || from == get_self()) return;
-    eosio::check(false, "this address should not accept tokens");
+void evmutil::dropqueued(uint64_t id) {
+    require_auth(get_self());
+
+    queued_msg_table_t queue(_self, _self.value);
+    auto itr = queue.find(id);
+    eosio::check(itr != queue.end(), "queued message not found");
+    queue.erase(itr);
 }
 
-void evmutil::onbridgemsg(const bridge_message_t &message) {
-    config_t config = get_config();
+void evmutil::setcoalesce(uint8_t kind, bool enabled) {
+    require_auth(get_self());
+    eosio::check(kind <= uint8_t(route_kind::erc20_stake), "unknown route kind");
 
-    check(get_sender() == config.evm_account, "invalid sender of onbridgemsg");
+    claim_config_singleton_t claim_config(_self, _self.value);
+    claim_config_t v = claim_config.get_or_default();
+    if (enabled) v.route_kinds |= uint8_t(1u << kind);
+    else v.route_kinds &= uint8_t(~(1u << kind));
 
-    const bridge_message_v0 &msg = std::get<bridge_message_v0>(message);
-    check(msg.receiver == receiver_account(), "invalid message receiver");
+    if (v.route_kinds == 0) claim_config.remove();
+    else claim_config.set(v, _self);
+}
 
-    helpers_t helpers = get_helpers();
+void evmutil::setstaketrf(bool single_transfer) {
+    require_auth(get_self());
 
-    if (helpers.reward_helper_address == msg.sender) {
-        handle_rewards(msg);
-    }
-    else if (helpers.btc_deposit_address && helpers.btc_deposit_address.value() == msg.sender) {
-        // Reuse old logic. We KNOW the target is XBTC and delta-precision is 10
-        handle_endorser_stakes(msg, 10, true, false);
-    }
-    else if (helpers.xsat_deposit_address && helpers.xsat_deposit_address.value() == msg.sender) {
-        // Reuse old logic. We KNOW the target is XSAT and delta-precision is 10
-        handle_endorser_stakes(msg, 10, true, true);
-    }
-    else if (helpers.gas_funds_address && helpers.gas_funds_address.value() == msg.sender){
-        handle_gasfunds(msg);
+    stake_config_singleton_t stake_config(_self, _self.value);
+    stake_config_t v = stake_config.get_or_default();
+    v.single_transfer = single_transfer;
+
+    if (!v.single_transfer) stake_config.remove();
+    else stake_config.set(v, _self);
+}
+
+void evmutil::pruneclaims(uint32_t max_rows) {
+    eosio::check(max_rows > 0, "max_rows must be positive");
+
+    const uint32_t block_num = eosio::current_block_number();
+    claim_log_table_t log(_self, _self.value);
+    for (auto itr = log.begin(); itr != log.end() && max_rows > 0; --max_rows) {
+        if (itr->block_num < block_num) itr = log.erase(itr);
+        else ++itr;
     }
-    else {
-        checksum256 addr_key = make_key(msg.sender);
-        token_table_t token_table(_self, _self.value);
-        auto index = token_table.get_index<"by.address"_n>();
-        auto itr = index.find(addr_key);
+}
 
-        check(itr != index.end() && itr->address == msg.sender, "ERC-20 token not registerred");
+void evmutil::dispatch_bridge_message(action_context &ctx, const bridge_message_view &msg) {
+    check(msg.receiver == receiver_account(), "invalid message receiver");
+    check(msg.sender.size() == kAddressLength, "invalid message sender");
 
-        handle_endorser_stakes(msg, itr->erc20_precision - config.evm_gas_token_symbol.precision(), false, false);
+    route_table_t routes(_self, _self.value);
+    auto itr = find_route(routes, msg.sender);
+    if (itr != routes.end()) {
+        ctx.sender_route = *itr;
+    }
+    else {
+        // Contracts upgraded in place have no routes until migtokens and syncroutes ran, keep serving their senders.
+        ctx.sender_route = find_legacy_route(ctx.state, msg.sender);
+        check(ctx.sender_route.has_value(), "ERC-20 token not registerred");
+    }
+    const route_t &route = *ctx.sender_route;
+
+    switch (route.get_kind()) {
+    case route_kind::rewards:
+        handle_rewards(ctx, msg);
+        break;
+    case route_kind::btc_deposit:
+        ctx.route = stake_route{{route.delta_precision, route.multiplier}, true, false};
+        handle_endorser_stakes(ctx, msg);
+        break;
+    case route_kind::xsat_deposit:
+        ctx.route = stake_route{{route.delta_precision, route.multiplier}, true, true};
+        handle_endorser_stakes(ctx, msg);
+        break;
+    case route_kind::gas_funds:
+        handle_gasfunds(ctx, msg);
+        break;
+    case route_kind::erc20_stake:
+        ctx.route = stake_route{{route.delta_precision, route.multiplier}, false, false};
+        handle_endorser_stakes(ctx, msg);
+        break;
+    default:
+        check(false, "invalid route kind");
     }
 }
 
 void evmutil::init(eosio::name evm_account, eosio::symbol gas_token_symbol, uint64_t gaslimit, uint64_t init_gaslimit) {
     require_auth(get_self());
 
-    config_singleton_t config_table(get_self(), get_self().value);
-    eosio::check(!config_table.exists(), "evmutil config already initialized");
+    eosio::check(!config_initialized(), "evmutil config already initialized");
 
     config_t config;
     token_table_t token_table(_self, _self.value);
-    if (token_table.begin() != token_table.end()) {
+    token2_table_t token2_table(_self, _self.value);
+    if (token_table.begin() != token_table.end() || token2_table.begin() != token2_table.end()) {
         eosio::check(evm_account == default_evm_account && gas_token_symbol == default_native_token_symbol, "can only init with native EOS symbol");
     }
     config.evm_account = evm_account;
@@ -679,172 +1207,697 @@ void evmutil::setdepfee(std::string proxy_address, const eosio::asset &fee) {
     eosio::check(!!address_bytes, "token address must be valid 0x EVM address");
     eosio::check(address_bytes->size() == kAddressLength, "invalid length of token address");
 
-    checksum256 addr_key = make_key(*address_bytes);
-    token_table_t token_table(_self, _self.value);
-    auto index = token_table.get_index<"by.address"_n>();
-    auto token_table_iter = index.find(addr_key);
+    const std::optional<route_t> route = find_proxy_route(*address_bytes);
+    check(route && route->get_kind() == route_kind::erc20_stake, "ERC-20 token not registerred");
 
-    check(token_table_iter != index.end() && token_table_iter->address == address_bytes, "ERC-20 token not registerred");
+    eosio::check(fee.amount >= 0, "deposit_fee must not be negative");
+    intx::uint256 fee_evm = to_evm_amount(fee.amount, gas_token_scale(config.evm_gas_token_symbol));
 
-    intx::uint256 fee_evm = fee.amount;
-    fee_evm *= get_minimum_natively_representable(config);
+    evm_call_payload payload(receiver_account(), *address_bytes, 4 + 32);
+    payload.data().selector(evm_calls::set_fee).word(fee_evm).finish();
+    payload.send(config.evm_account, {receiver_account(), "active"_n}, config.evm_gaslimit);
+}
 
-    auto pack_uint256 = [&](bytes &ds, const intx::uint256 &val) {
-        uint8_t val_[32] = {};
-        intx::be::store(val_, val);
-        ds.insert(ds.end(), val_, val_ + sizeof(val_));
-    };
+void evmutil::setlocktime(std::string proxy_address, uint64_t locktime) {
+    require_auth(get_self());
+
+    action_context ctx = load_context(false);
 
-    bytes call_data;
-    // sha(setFee(uint256)) == 0x69fe0e2d
-    uint8_t func_[4] = {0x69,0xfe,0x0e,0x2d};
-    call_data.insert(call_data.end(), func_, func_ + sizeof(func_));
-    pack_uint256(call_data, fee_evm);
 
-    bytes value_zero;
-    value_zero.resize(32, 0);
+    auto address_bytes = from_hex(proxy_address);
+    eosio::check(!!address_bytes, "token address must be valid 0x EVM address");
+    eosio::check(address_bytes->size() == kAddressLength, "invalid length of token address");
+
+    // Stake helper proxies are either registered tokens or validator deposit helpers.
+    const std::optional<route_t> route = find_proxy_route(*address_bytes);
+    check(route &&
+          (route->get_kind() == route_kind::erc20_stake ||
+           route->get_kind() == route_kind::btc_deposit ||
+           route->get_kind() == route_kind::xsat_deposit), "ERC-20 token not registerred");
 
-    evm_runtime::call_action call_act(config.evm_account, {{receiver_account(), "active"_n}});
-    call_act.send(receiver_account(), token_table_iter->address, value_zero, call_data, config.evm_gaslimit);
+    evm_call_payload payload(receiver_account(), *address_bytes, 4 + 32);
+    payload.data().selector(evm_calls::set_lock_time).word(locktime).finish();
+    payload.send(ctx.config.evm_account, {receiver_account(), "active"_n}, ctx.config.evm_gaslimit);
 }
 
-void evmutil::setlocktime(std::string proxy_address, uint64_t locktime) {
+void evmutil::upstakeimpl(std::string proxy_address) {
     require_auth(get_self());
 
-    config_t config = get_config();
-
+    action_context ctx = load_context(false);
 
     auto address_bytes = from_hex(proxy_address);
     eosio::check(!!address_bytes, "token address must be valid 0x EVM address");
     eosio::check(address_bytes->size() == kAddressLength, "invalid length of token address");
 
-    helpers_t helpers = get_helpers();
+    // Stake helper proxies are either registered tokens or validator deposit helpers.
+    const std::optional<route_t> route = find_proxy_route(*address_bytes);
+    check(route &&
+          (route->get_kind() == route_kind::erc20_stake ||
+           route->get_kind() == route_kind::btc_deposit ||
+           route->get_kind() == route_kind::xsat_deposit), "ERC-20 token not registerred");
+    check(!route->is_beacon_proxy(), "beacon proxies are upgraded through setbeaconimpl");
+
+    const impl_contract_t impl = current_impl();
+    set_proxy_impl(*address_bytes, impl.id);
+
+    // upgradeToAndCall(address newImplementation, bytes memory data) with empty data
+    evm_call_payload payload(receiver_account(), *address_bytes, 4 + 3 * 32);
+    abi_encoder call_data = payload.data();
+    call_data.selector(evm_calls::upgrade_to_and_call)
+             .address(impl.address)
+             .word(64);                                        // offset of data
+    call_data.end_bytes(call_data.begin_bytes(0))
+             .finish();
+    payload.send(ctx.config.evm_account, {receiver_account(), "active"_n}, ctx.config.evm_gaslimit);
+}
 
-    if (!((helpers.btc_deposit_address && helpers.btc_deposit_address.value() == *address_bytes) ||
-        (helpers.xsat_deposit_address && helpers.xsat_deposit_address.value() == *address_bytes))) {
-        checksum256 addr_key = make_key(*address_bytes);
-        token_table_t token_table(_self, _self.value);
-        auto index = token_table.get_index<"by.address"_n>();
-        auto token_table_iter = index.find(addr_key);
+void evmutil::startfleet(eosio::name op, std::optional<eosio::asset> fee, std::optional<uint64_t> locktime, std::optional<std::string> dest) {
+    require_auth(get_self());
+
+    fleet_job_singleton_t jobs(_self, _self.value);
+    eosio::check(!jobs.exists(), "fleet job already running");
+    check_tokens_migrated();
 
-        check(token_table_iter != index.end() && token_table_iter->address == address_bytes, "ERC-20 token not registerred");
+    config_t config = get_config();
+    fleet_job_t job;
+    job.op = op;
+    job.arg.resize(32);
+    abi_encoder arg(job.arg.data(), job.arg.size());
+
+    if (op == fleet_op::set_fee) {
+        eosio::check(fee.has_value(), "missing fee");
+        eosio::check(fee->symbol == config.evm_gas_token_symbol, "deposit_fee should have native token symbol");
+        eosio::check(fee->amount >= 0, "deposit_fee must not be negative");
+        arg.word(to_evm_amount(fee->amount, gas_token_scale(config.evm_gas_token_symbol)));
+        // Same as setdepfee(), which only applies to registered tokens.
+        job.cursor = fleet_token_cursor;
+    }
+    else if (op == fleet_op::set_lock_time) {
+        eosio::check(locktime.has_value(), "missing locktime");
+        arg.word(*locktime);
     }
+    else if (op == fleet_op::upgrade_impl) {
+        const impl_contract_t impl = current_impl();
+        arg.address(impl.address);
+        job.impl_id = impl.id;
+    }
+    else if (op == fleet_op::collect_fee) {
+        eosio::check(dest.has_value(), "missing dest");
+        auto dest_bytes = from_hex(*dest);
+        eosio::check(!!dest_bytes, "dest must be valid 0x EVM address");
+        eosio::check(dest_bytes->size() == kAddressLength, "invalid length of dest address");
+        arg.address(*dest_bytes);
+    }
+    else {
+        eosio::check(false, "unknown fleet operation");
+    }
+    arg.finish();
 
-    auto pack_uint256 = [&](bytes &ds, const intx::uint256 &val) {
-        uint8_t val_[32] = {};
-        intx::be::store(val_, val);
-        ds.insert(ds.end(), val_, val_ + sizeof(val_));
-    };
+    jobs.set(job, _self);
+}
+
+void evmutil::runfleet(uint32_t max_proxies) {
+    require_auth(get_self());
+    eosio::check(max_proxies > 0 && max_proxies <= max_fleet_chunk, "max_proxies out of range");
+
+    fleet_job_singleton_t jobs(_self, _self.value);
+    eosio::check(jobs.exists(), "no fleet job running");
+    fleet_job_t job = jobs.get();
+
+    action_context ctx = load_context();
+    token2_table_t token_table(_self, _self.value);
+    route_table_t routes(_self, _self.value);
+
+    bool done = false;
+    for (uint32_t count = 0; count < max_proxies;) {
+        bytes proxy;
+        if (job.cursor == fleet_btc_deposit_cursor) {
+            if (ctx.helpers.btc_deposit_address.has_value()) proxy = ctx.helpers.btc_deposit_address.value();
+            ++job.cursor;
+        }
+        else if (job.cursor == fleet_xsat_deposit_cursor) {
+            if (ctx.helpers.xsat_deposit_address.has_value()) proxy = ctx.helpers.xsat_deposit_address.value();
+            ++job.cursor;
+        }
+        else {
+            auto itr = token_table.lower_bound(job.cursor - fleet_token_cursor);
+            if (itr == token_table.end()) {
+                done = true;
+                break;
+            }
+            proxy = key160_bytes(itr->address);
+            job.cursor = itr->id + fleet_token_cursor + 1;
+        }
+
+        if (proxy.empty()) continue;
+        ++count;
+
+        // setbeaconimpl upgrades every beacon proxy at once, and upgradeToAndCall would revert on them.
+        if (job.op == fleet_op::upgrade_impl) {
+            auto route_itr = find_route(routes, proxy);
+            if (route_itr != routes.end() && route_itr->is_beacon_proxy()) continue;
+        }
+        send_fleet_call(ctx, job, proxy);
+        ++job.processed;
+    }
 
-    bytes call_data;
-    // sha(setLockTime(uint256)) == 0xae04d45d
-    uint8_t func_[4] = {0xae,0x04,0xd4,0x5d};
-    call_data.insert(call_data.end(), func_, func_ + sizeof(func_));
-    pack_uint256(call_data, intx::uint256(locktime));
+    // A full chunk may have ended right at the last token.
+    if (!done && job.cursor >= fleet_token_cursor) {
+        done = token_table.lower_bound(job.cursor - fleet_token_cursor) == token_table.end();
+    }
+
+    if (done) jobs.remove();
+    else jobs.set(job, _self);
+}
 
-    bytes value_zero;
-    value_zero.resize(32, 0);
+void evmutil::cancelfleet() {
+    require_auth(get_self());
 
-    evm_runtime::call_action call_act(config.evm_account, {{receiver_account(), "active"_n}});
-    call_act.send(receiver_account(), *address_bytes, value_zero, call_data, config.evm_gaslimit);
+    fleet_job_singleton_t jobs(_self, _self.value);
+    eosio::check(jobs.exists(), "no fleet job running");
+    jobs.remove();
 }
 
-void evmutil::upstakeimpl(std::string proxy_address) {
+void evmutil::send_fleet_call(const action_context &ctx, const fleet_job_t &job, const bytes &proxy) {
+    // Every admin function of StakeHelper checks that the caller is evmutil itself,
+    // so each proxy gets its own call instead of one aggregated through a router contract.
+    if (job.op == fleet_op::upgrade_impl) {
+        set_proxy_impl(proxy, job.impl_id);
+
+        // upgradeToAndCall(address newImplementation, bytes memory data) with empty data
+        evm_call_payload payload(receiver_account(), proxy, 4 + 3 * 32);
+        abi_encoder call_data = payload.data();
+        call_data.selector(evm_calls::upgrade_to_and_call)
+                 .raw(job.arg.data(), job.arg.size())
+                 .word(64);                                    // offset of data
+        call_data.end_bytes(call_data.begin_bytes(0))
+                 .finish();
+        payload.send(ctx.config.evm_account, {receiver_account(), "active"_n}, ctx.config.evm_gaslimit);
+        return;
+    }
+
+    uint32_t selector = 0;
+    if (job.op == fleet_op::set_fee) selector = evm_calls::set_fee;
+    else if (job.op == fleet_op::set_lock_time) selector = evm_calls::set_lock_time;
+    else if (job.op == fleet_op::collect_fee) selector = evm_calls::collect_fee;
+    else eosio::check(false, "unknown fleet operation");
+
+    evm_call_payload payload(receiver_account(), proxy, 4 + 32);
+    payload.data().selector(selector).raw(job.arg.data(), job.arg.size()).finish();
+    payload.send(ctx.config.evm_account, {receiver_account(), "active"_n}, ctx.config.evm_gaslimit);
+}
+
+void evmutil::dpygasfunds() {
+    require_auth(get_self());
+
+    action_context ctx = load_context();
+    deploy_gas_funds(ctx);
+    commit_context(ctx);
+}
+void evmutil::initgasfund() {
     require_auth(get_self());
 
     config_t config = get_config();
 
-    auto address_bytes = from_hex(proxy_address);
-    eosio::check(!!address_bytes, "token address must be valid 0x EVM address");
-    eosio::check(address_bytes->size() == kAddressLength, "invalid length of token address");
+    if (!config.gasfund_account.has_value()) {
+        config.gasfund_account = default_gasfund_account;
+    }
+    set_config(config);
+}
 
-    helpers_t helpers = get_helpers();
+void evmutil::dpyfactory() {
+    require_auth(get_self());
+
+    action_context ctx = load_context();
+    eosio::check(!ctx.helpers.deploy_factory_address.has_value() || ctx.helpers.deploy_factory_address.value().empty(), "deploy factory already set");
+
+    // The factory itself is deployed through the nonce, as no factory is set yet.
+    bytecode_t code = find_code(code_kind::deploy_factory);
+    bytes factory_addr = deploy_contract(ctx, code.size, {},
+                                         [&](abi_encoder &out) { write_code(out, code_kind::deploy_factory, code); });
+
+    set_deploy_factory(ctx.helpers, factory_addr);
+    ctx.mark_helpers();
+    commit_context(ctx);
+}
 
-    if (!((helpers.btc_deposit_address && helpers.btc_deposit_address.value() == *address_bytes) ||
-        (helpers.xsat_deposit_address && helpers.xsat_deposit_address.value() == *address_bytes))) {
-        checksum256 addr_key = make_key(*address_bytes);
-        token_table_t token_table(_self, _self.value);
-        auto index = token_table.get_index<"by.address"_n>();
-        auto token_table_iter = index.find(addr_key);
+void evmutil::setfactory(std::string factory_address) {
+    require_auth(get_self());
 
-        check(token_table_iter != index.end() && token_table_iter->address == address_bytes, "ERC-20 token not registerred");
+    bytes address_bytes;
+    if (!factory_address.empty()) {
+        auto address_bytes_opt = from_hex(factory_address);
+        eosio::check(!!address_bytes_opt, "factory address must be valid 0x EVM address");
+        eosio::check(address_bytes_opt->size() == kAddressLength, "invalid length of factory address");
+        address_bytes = *address_bytes_opt;
     }
 
-    impl_contract_table_t contract_table(_self, _self.value);
-    eosio::check(contract_table.begin() != contract_table.end(), "no implementaion contract available");
-    auto contract_itr = contract_table.end();
-    --contract_itr;
+    helpers_t helpers = get_helpers();
+    set_deploy_factory(helpers, address_bytes);
+    set_helpers(helpers);
+}
 
+void evmutil::setproxymode(uint8_t mode) {
+    require_auth(get_self());
+    eosio::check(mode <= uint8_t(proxy_mode::beacon), "invalid proxy mode");
 
-    auto pack_uint32 = [&](bytes &ds, uint32_t val) {
-        uint8_t val_[32] = {};
-        val_[28] = (uint8_t)(val >> 24);
-        val_[29] = (uint8_t)(val >> 16);
-        val_[30] = (uint8_t)(val >> 8);
-        val_[31] = (uint8_t)val;
-        ds.insert(ds.end(), val_, val_ + sizeof(val_));
-    };
+    config_t config = get_config();
+    config.stake_proxy_mode = mode;
+    set_config(config);
+}
 
-    bytes call_data;
-    // sha(upgradeToAndCall(address,bytes)) == 4f1ef286
-    uint8_t func_[4] = {0x4f,0x1e,0xf2,0x86};
-    call_data.insert(call_data.end(), func_, func_ + sizeof(func_));
+void evmutil::uploadcode(eosio::name kind, uint32_t version, uint32_t chunk_index, const bytes &data) {
+    require_auth(get_self());
+    eosio::check(code_kind::is_known(kind), "unknown bytecode kind");
+    eosio::check(!data.empty(), "empty bytecode chunk");
+
+    bytecode_table_t codes(_self, kind.value);
+    auto itr = codes.find(version);
+    if (itr == codes.end()) {
+        eosio::check(chunk_index == 0, "unexpected bytecode chunk index");
+        itr = codes.emplace(_self, [&](auto &v) {
+            v.version = version;
+        });
+    }
+    eosio::check(!itr->finalized, "bytecode already finalized");
+    eosio::check(chunk_index == itr->chunk_count, "unexpected bytecode chunk index");
 
+    code_chunk_table_t chunks(_self, kind.value);
+    chunks.emplace(_self, [&](auto &v) {
+        v.id = code_chunk_t::chunk_key(version, chunk_index);
+        v.data = data;
+    });
+    codes.modify(itr, _self, [&](auto &v) {
+        v.size += data.size();
+        v.chunk_count += 1;
+    });
+}
 
-    call_data.insert(call_data.end(), 32 - kAddressLength, 0);  // padding for address offset 0
-    call_data.insert(call_data.end(), contract_itr->address.begin(), contract_itr->address.end());
+void evmutil::finalizecode(eosio::name kind, uint32_t version, const checksum256 &hash) {
+    require_auth(get_self());
+    eosio::check(code_kind::is_known(kind), "unknown bytecode kind");
+
+    bytecode_table_t codes(_self, kind.value);
+    auto itr = codes.find(version);
+    eosio::check(itr != codes.end(), "bytecode not found");
+    eosio::check(!itr->finalized, "bytecode already finalized");
+    eosio::check(itr->size > 0, "empty bytecode");
+
+    // The whole bytecode is assembled once here, deployments then stream the checked chunks.
+    bytes code(itr->size);
+    abi_encoder out(code.data(), code.size());
+    write_code(out, kind, *itr);
+    out.finish();
+    eosio::check(eosio::sha256(code.data(), code.size()) == hash, "bytecode hash mismatch");
+
+    codes.modify(itr, _self, [&](auto &v) {
+        v.finalized = true;
+        v.hash = hash;
+    });
+}
 
-    pack_uint32(call_data, 64);                      // offset 32
-    pack_uint32(call_data, 0);                      // offset 64
+void evmutil::rmcode(eosio::name kind, uint32_t version) {
+    require_auth(get_self());
 
-    bytes value_zero;
-    value_zero.resize(32, 0);
+    bytecode_table_t codes(_self, kind.value);
+    auto itr = codes.find(version);
+    eosio::check(itr != codes.end(), "bytecode not found");
 
-    evm_runtime::call_action call_act(config.evm_account, {{receiver_account(), "active"_n}});
-    call_act.send(receiver_account(), *address_bytes, value_zero, call_data, config.evm_gaslimit);
+    code_chunk_table_t chunks(_self, kind.value);
+    auto chunk_itr = chunks.lower_bound(code_chunk_t::chunk_key(version, 0));
+    while (chunk_itr != chunks.end() && chunk_itr->id < code_chunk_t::chunk_key(version, itr->chunk_count)) {
+        chunk_itr = chunks.erase(chunk_itr);
+    }
+    codes.erase(itr);
 }
 
-void evmutil::dpygasfunds() {
+void evmutil::dpybeacon() {
     require_auth(get_self());
-    config_t config = get_config();
 
-    bytes call_data;
+    action_context ctx = load_context();
+    eosio::check(!ctx.helpers.beacon_address.has_value() || ctx.helpers.beacon_address.value().empty(), "stake helper beacon already deployed");
+
+    const impl_contract_t impl = current_impl();
 
-    auto reserved_addr = silkworm::make_reserved_address(receiver_account().value);
+    auto reserved_addr = make_reserved_address(receiver_account().value);
+    bytecode_t code = find_code(code_kind::beacon);
+
+    // constructor(address _owner, address _implementation)
+    bytes beacon_addr = deploy_contract(ctx, code.size + 2 * 32, make_deploy_salt(deploy_tag::beacon), [&](abi_encoder &out) {
+        write_code(out, code_kind::beacon, code);
+        out.address(reserved_addr.data())
+           .address(impl.address);
+    });
 
+    impl_registry_singleton_t registry(_self, _self.value);
+    impl_registry_t reg = registry.get_or_default({impl.id});
+    move_impl_ref(reg.beacon_impl_id, impl.id);
+    reg.beacon_impl_id = impl.id;
+    registry.set(reg, _self);
 
-    initialize_data(call_data, solidity::gasfunds::bytecode);
+    emplace_helper_extensions(ctx.helpers);
+    ctx.helpers.beacon_address = beacon_addr;
+    ctx.mark_helpers();
+    commit_context(ctx);
+}
 
-    bytes to = {};
-    bytes value_zero;
-    value_zero.resize(32, 0);
+void evmutil::setbeaconimpl() {
+    require_auth(get_self());
 
-    uint64_t next_nonce = get_next_nonce();
+    action_context ctx = load_context();
+    eosio::check(ctx.helpers.beacon_address.has_value() && !ctx.helpers.beacon_address.value().empty(), "stake helper beacon not deployed");
+
+    const impl_contract_t impl = current_impl();
+    impl_registry_singleton_t registry(_self, _self.value);
+    impl_registry_t reg = registry.get_or_default({impl.id});
+    move_impl_ref(reg.beacon_impl_id, impl.id);
+    reg.beacon_impl_id = impl.id;
+    registry.set(reg, _self);
+
+    // upgradeTo(address _newImplementation) on the beacon upgrades every beacon proxy at once
+    evm_call_payload payload(receiver_account(), ctx.helpers.beacon_address.value(), 4 + 32);
+    payload.data()
+           .selector(evm_calls::beacon_upgrade_to)
+           .address(impl.address)
+           .finish();
+    payload.send(ctx.config.evm_account, {receiver_account(), "active"_n}, ctx.config.evm_gaslimit);
+}
 
-    // required account opened in evm_runtime
-    evm_runtime::call_action call_act(config.evm_account, {{receiver_account(), "active"_n}});
+void evmutil::syncroutes() {
+    require_auth(get_self());
 
-    call_act.send(receiver_account(), to, value_zero, call_data, config.evm_init_gaslimit);
+    config_t config = get_config();
+    sync_helper_routes(config);
 
-    evmc::address impl_addr = silkworm::create_address(reserved_addr, next_nonce);
+    check_tokens_migrated();
+    token2_table_t token_table(_self, _self.value);
+    for (auto itr = token_table.begin(); itr != token_table.end(); ++itr) {
+        set_route(key160_bytes(itr->address), route_kind::erc20_stake, get_delta_precision(config, itr->erc20_precision));
+    }
+}
 
+void evmutil::sync_helper_routes(const config_t &config) {
     helpers_t helpers = get_helpers();
+    route_table_t routes(_self, _self.value);
 
-    bytes impl_addr_bytes;
-    impl_addr_bytes.resize(kAddressLength, 0);
-    memcpy(&(impl_addr_bytes[0]), impl_addr.bytes, kAddressLength);
-    helpers.gas_funds_address = impl_addr_bytes;
-    set_helpers(helpers);
+    // Deposit helpers keep the precision of an existing route, older ones get the legacy precision.
+    auto deposit_delta = [&](const bytes &address) {
+        auto itr = find_route(routes, address);
+        return itr != routes.end() ? itr->delta_precision : legacy_deposit_delta(config.evm_gas_token_symbol);
+    };
+
+    if (!helpers.reward_helper_address.empty()) {
+        set_route(helpers.reward_helper_address, route_kind::rewards, 0);
+    }
+    if (helpers.btc_deposit_address && !helpers.btc_deposit_address.value().empty()) {
+        set_route(helpers.btc_deposit_address.value(), route_kind::btc_deposit, deposit_delta(helpers.btc_deposit_address.value()));
+    }
+    if (helpers.xsat_deposit_address && !helpers.xsat_deposit_address.value().empty()) {
+        set_route(helpers.xsat_deposit_address.value(), route_kind::xsat_deposit, deposit_delta(helpers.xsat_deposit_address.value()));
+    }
+    if (helpers.gas_funds_address && !helpers.gas_funds_address.value().empty()) {
+        set_route(helpers.gas_funds_address.value(), route_kind::gas_funds, 0);
+    }
 }
-void evmutil::initgasfund() {
+
+void evmutil::migtokens(uint32_t max_rows) {
     require_auth(get_self());
+    eosio::check(max_rows > 0, "max_rows must be positive");
 
     config_t config = get_config();
+    token_table_t token_table(_self, _self.value);
+    token2_table_t token2_table(_self, _self.value);
+    eosio::check(token_table.begin() != token_table.end(), "token table already migrated");
+
+    for (auto itr = token_table.begin(); itr != token_table.end() && max_rows > 0; --max_rows) {
+        eosio::check(itr->address.size() == kAddressLength && itr->token_address.size() == kAddressLength, "invalid length of token address");
+        token2_table.emplace(_self, [&](auto &v) {
+            v.id = itr->id;
+            v.address = make_key160(byte_span(itr->address));
+            v.token_address = make_key160(byte_span(itr->token_address));
+            v.erc20_precision = itr->erc20_precision;
+            v.multiplier = precision_scale::of(get_delta_precision(config, itr->erc20_precision)).multiplier;
+        });
+        set_route(itr->address, route_kind::erc20_stake, get_delta_precision(config, itr->erc20_precision));
+        itr = token_table.erase(itr);
+    }
 
-    if (!config.gasfund_account.has_value()) {
-        config.gasfund_account = default_gasfund_account;
+    // Bridge messages stop falling back to the legacy tables now, the helpers need their routes too.
+    if (token_table.begin() == token_table.end()) sync_helper_routes(config);
+}
+
+std::vector<table_stats> evmutil::getstats(uint32_t max_rows) {
+    eosio::check(max_rows > 0, "max_rows must be positive");
+
+    static constexpr eosio::name tables[] = {
+        "config"_n, "helpers"_n, state_record::table, "implreg"_n, "implcontract"_n,
+        "tokens"_n, "tokens2"_n, "routes"_n, "fleetjob"_n, "deploycount"_n, "implcount"_n, "queuecfg"_n, "msgqueue"_n, "claimcfg"_n, "claimlog"_n, "stakecfg"_n,
+    };
+
+    std::vector<table_stats> result;
+    result.reserve(std::size(tables) + 2 * std::size(code_kind::all));
+    for (auto table : tables) {
+        result.push_back(scan_table(table, _self, max_rows));
+    }
+    for (auto kind : code_kind::all) {
+        result.push_back(scan_table("bytecodes"_n, kind, max_rows));
+        result.push_back(scan_table("codechunks"_n, kind, max_rows));
+    }
+    return result;
+}
+
+route_page evmutil::getroutes(uint64_t lower_key, uint32_t limit) {
+    eosio::check(limit > 0 && limit <= max_route_page, "limit out of range");
+
+    const config_t config = get_config();
+    route_table_t routes(_self, _self.value);
+    token2_table_t token_table(_self, _self.value);
+    auto token_index = token_table.get_index<"by.address"_n>();
+
+    route_page page;
+    page.routes.reserve(limit);
+    auto itr = routes.lower_bound(lower_key);
+    for (; itr != routes.end() && page.routes.size() < limit; ++itr) {
+        route_info info;
+        info.key = itr->key;
+        info.address = to_hex(itr->sender);
+        info.kind = itr->kind;
+
+        switch (itr->get_kind()) {
+        case route_kind::erc20_stake: {
+            auto token_itr = find_token(token_index, &token2_t::address, itr->sender);
+            if (token_itr != token_index.end()) {
+                info.token_address = to_hex(token_itr->token_address);
+            }
+            info.erc20_precision = config.evm_gas_token_symbol.precision() + itr->delta_precision;
+            break;
+        }
+        case route_kind::btc_deposit:
+        case route_kind::xsat_deposit:
+            info.erc20_precision = config.evm_gas_token_symbol.precision() + itr->delta_precision;
+            break;
+        default:
+            break;
+        }
+        page.routes.push_back(std::move(info));
+    }
+    if (itr != routes.end()) page.next_key = itr->key;
+    return page;
+}
+
+table_stats evmutil::scan_table(eosio::name table, eosio::name scope, uint32_t max_rows) const {
+    using namespace eosio::internal_use_do_not_use;
+    table_stats stats;
+    stats.table = table;
+    stats.scope = scope;
+
+    // Walk backwards from the end, since db_previous_i64 is what yields the primary key of each row.
+    // Only sizes are read, rows are never unpacked.
+    uint64_t key = 0;
+    int32_t itr = db_end_i64(_self.value, scope.value, table.value);
+    if (itr == -1) return stats;  // table never created
+    while ((itr = db_previous_i64(itr, &key)) >= 0) {
+        if (stats.rows == max_rows) {
+            stats.complete = false;
+            break;
+        }
+        const uint32_t size = db_get_i64(itr, nullptr, 0);
+        ++stats.rows;
+        stats.total_size += size;
+        if (size > stats.largest_size) {
+            stats.largest_size = size;
+            stats.largest_key = key;
+        }
+    }
+    return stats;
+}
+
+void evmutil::check_tokens_migrated() const {
+    token_table_t token_table(_self, _self.value);
+    eosio::check(token_table.begin() == token_table.end(), "token table migration pending");
+}
+
+impl_contract_t evmutil::current_impl() const {
+    impl_contract_table_t contract_table(_self, _self.value);
+    impl_registry_singleton_t registry(_self, _self.value);
+    if (registry.exists()) {
+        auto itr = contract_table.find(registry.get().current_id);
+        eosio::check(itr != contract_table.end(), "no implementaion contract available");
+        return *itr;
+    }
+
+    eosio::check(contract_table.begin() != contract_table.end(), "no implementaion contract available");
+    auto itr = contract_table.end();
+    --itr;
+    return *itr;
+}
+
+uint64_t evmutil::add_impl(const bytes &address) {
+    eosio::check(address.size() == kAddressLength, "invalid length of implementation address");
+
+    impl_contract_table_t contract_table(_self, _self.value);
+    const uint64_t id = contract_table.available_primary_key();
+    contract_table.emplace(_self, [&](auto &v) {
+        v.id = id;
+        v.address = address;
+        v.proxy_count.emplace(0);
+    });
+
+    impl_registry_singleton_t registry(_self, _self.value);
+    impl_registry_t reg = registry.get_or_default();
+    reg.current_id = id;
+    registry.set(reg, _self);
+    return id;
+}
+
+void evmutil::move_impl_ref(std::optional<uint64_t> from, std::optional<uint64_t> to) {
+    if (from == to) return;
+    eosio::check(!impl_recount_singleton_t(_self, _self.value).exists(), "implementation recount running");
+
+    impl_contract_table_t contract_table(_self, _self.value);
+    if (from) {
+        auto itr = contract_table.find(*from);
+        if (itr != contract_table.end() && itr->proxy_count.has_value() && itr->proxy_count.value() > 0) {
+            contract_table.modify(itr, _self, [&](auto &v) { v.proxy_count.emplace(v.proxy_count.value() - 1); });
+        }
+    }
+    if (to) {
+        auto itr = contract_table.find(*to);
+        eosio::check(itr != contract_table.end(), "no implementaion contract available");
+        if (itr->proxy_count.has_value()) {
+            contract_table.modify(itr, _self, [&](auto &v) { v.proxy_count.emplace(v.proxy_count.value() + 1); });
+        }
+    }
+}
+
+void evmutil::set_proxy_impl(const bytes &proxy, std::optional<uint64_t> impl_id, std::optional<proxy_mode> mode) {
+    route_table_t routes(_self, _self.value);
+    auto itr = find_route(routes, proxy);
+    if (itr == routes.end()) {
+        // Proxies only known to the legacy tables get their route now, so the implementation can be recorded.
+        const std::optional<route_t> legacy = find_legacy_route(current_state(), proxy);
+        eosio::check(legacy.has_value(), "ERC-20 token not registerred");
+        set_route(proxy, legacy->get_kind(), legacy->delta_precision);
+        itr = find_route(routes, proxy);
+    }
+
+    const std::optional<uint64_t> old_id = itr->tracked_impl();
+    if (old_id == impl_id && !mode) return;
+
+    move_impl_ref(old_id, impl_id);
+    routes.modify(itr, _self, [&](auto &v) {
+        // impl_id stays present, even when untracked, so that deploy_mode can follow it.
+        v.impl_id.emplace(impl_id ? *impl_id : route_t::untracked_impl);
+        if (mode) v.deploy_mode.emplace(uint8_t(*mode));
+    });
+}
+
+void evmutil::setcurimpl(uint64_t id) {
+    require_auth(get_self());
+
+    impl_contract_table_t contract_table(_self, _self.value);
+    eosio::check(contract_table.find(id) != contract_table.end(), "no implementaion contract available");
+
+    impl_registry_singleton_t registry(_self, _self.value);
+    impl_registry_t reg = registry.get_or_default();
+    reg.current_id = id;
+    registry.set(reg, _self);
+}
+
+void evmutil::recountimpl(uint64_t legacy_impl_id, uint32_t max_rows) {
+    require_auth(get_self());
+    eosio::check(max_rows > 0, "max_rows must be positive");
+
+    impl_contract_table_t contract_table(_self, _self.value);
+    impl_recount_singleton_t recount(_self, _self.value);
+    impl_recount_t job;
+    if (recount.exists()) {
+        job = recount.get();
+    }
+    else {
+        eosio::check(contract_table.find(legacy_impl_id) != contract_table.end(), "no implementaion contract available");
+        job.legacy_impl_id = legacy_impl_id;
+
+        // Every row restarts from the beacon reference, the proxies are added by the walk below.
+        impl_registry_singleton_t registry(_self, _self.value);
+        const impl_registry_t reg = registry.get_or_default();
+        for (auto itr = contract_table.begin(); itr != contract_table.end(); ++itr) {
+            contract_table.modify(itr, _self, [&](auto &v) { v.proxy_count.emplace(reg.beacon_impl_id == v.id ? 1 : 0); });
+        }
+    }
+
+    route_table_t routes(_self, _self.value);
+    bool done = false;
+    for (auto itr = routes.lower_bound(job.cursor); max_rows > 0; --max_rows) {
+        if (itr == routes.end()) {
+            done = true;
+            break;
+        }
+
+        const route_kind kind = itr->get_kind();
+        const bool is_proxy = kind == route_kind::erc20_stake || kind == route_kind::btc_deposit || kind == route_kind::xsat_deposit;
+        // Beacon proxies and untracked proxies hold no reference of their own.
+        if (is_proxy && !itr->is_beacon_proxy() && (!itr->impl_id.has_value() || itr->impl_id.value() != route_t::untracked_impl)) {
+            const uint64_t id = itr->impl_id.has_value() ? itr->impl_id.value() : job.legacy_impl_id;
+            auto impl_itr = contract_table.find(id);
+            if (impl_itr != contract_table.end()) {
+                contract_table.modify(impl_itr, _self, [&](auto &v) { v.proxy_count.emplace(v.proxy_count.value() + 1); });
+            }
+            if (!itr->impl_id.has_value()) {
+                routes.modify(itr, _self, [&](auto &v) { v.impl_id.emplace(id); });
+            }
+        }
+
+        if (itr->key == std::numeric_limits<uint64_t>::max()) {
+            done = true;
+            break;
+        }
+        job.cursor = itr->key + 1;
+        ++itr;
+    }
+    if (!done) done = routes.lower_bound(job.cursor) == routes.end();
+
+    if (done) recount.remove();
+    else recount.set(job, _self);
+}
+
+void evmutil::pruneimpl(uint64_t from_id, uint32_t max_rows) {
+    require_auth(get_self());
+    eosio::check(max_rows > 0, "max_rows must be positive");
+    eosio::check(!impl_recount_singleton_t(_self, _self.value).exists(), "implementation recount running");
+
+    impl_registry_singleton_t registry(_self, _self.value);
+    eosio::check(registry.exists(), "no implementaion contract available");
+    const impl_registry_t reg = registry.get();
+
+    impl_contract_table_t contract_table(_self, _self.value);
+    for (auto itr = contract_table.lower_bound(from_id); itr != contract_table.end() && max_rows > 0; --max_rows) {
+        const bool referenced = itr->id == reg.current_id ||
+                                (reg.beacon_impl_id && itr->id == *reg.beacon_impl_id) ||
+                                !itr->proxy_count.has_value() || itr->proxy_count.value() > 0;
+        if (referenced) ++itr;
+        else itr = contract_table.erase(itr);
     }
-    set_config(config);
 }
 
 void evmutil::setgasfunds(std::string impl_address) {
@@ -855,72 +1908,79 @@ void evmutil::setgasfunds(std::string impl_address) {
 
     helpers_t helpers = get_helpers();
     const auto& address_bytes = address_bytes_opt.value();
+    if (helpers.gas_funds_address) erase_route(helpers.gas_funds_address.value());
     helpers.gas_funds_address = bytes(address_bytes.begin(), address_bytes.end());
+    set_route(helpers.gas_funds_address.value(), route_kind::gas_funds, 0);
 
     set_helpers(helpers);
 }
-void evmutil::handle_gasfunds(const bridge_message_v0 &msg) {
-    config_t config = get_config();
-    check(msg.data.size() >= 4, "not enough data in bridge_message_v0");
+void evmutil::handle_gasfunds(action_context &ctx, const bridge_message_view &msg) {
+    static constexpr dispatch_entry<message_handler_t> entries[] = {
+        bind_view<calls::gasfunds_claim, &evmutil::handle_gasfunds_claim>(),
+        bind_view<calls::gasfunds_enfclaim, &evmutil::handle_gasfunds_enfclaim>(),
+        bind_view<calls::gasfunds_ramsclaim, &evmutil::handle_gasfunds_ramsclaim>(),
+    };
+    static constexpr auto handlers = make_dispatch_table(entries);
+    static_assert(handlers.unique(), "duplicated selector in gas funds handlers");
 
-    uint32_t app_type = 0;
-    memcpy((void *)&app_type, (const void *)&(msg.data[0]), sizeof(app_type));
+    const auto &entry = handlers.route(msg.data);
+    (this->*entry.handler)(ctx, msg);
+}
 
-    // 0x136f93b4 : 0xb4936f13 : claim(address,address,uint8)
-    // 0x4380f533 : 33f58043 : enfClaim(address)
-    // 0x031a7229 : 29721a03 : ramsClaim(address)
-    if (app_type == 0x136f93b4) {
-        check(msg.data.size() >= 4 + 32 /*to*/ + 32 /*from*/ ,
-            "not enough data in bridge_message_v0 of application type 0x42b3c021");
+void evmutil::handle_gasfunds_claim(action_context &ctx, const bridge_message_view &msg, const abi_view<calls::gasfunds_claim> &args) {
+    uint64_t dest_acc = args.get_account<0>();
+    checksum160 sender_addr = args.get_address<1>();
+    intx::uint256 receiver_type = args.get_uint<2>();
 
-        uint64_t dest_acc;
-        readExSatAccount(msg.data, 4, dest_acc);
+    gasfunds::evmclaim_action evmclaim_act(ctx.state.gasfund(), {{receiver_account(), "active"_n}});
+    ctx.emit(evmclaim_act.to_action(get_self(), make_key160(msg.sender), sender_addr, dest_acc, receiver_type));
+}
 
-        evmc::address sender_addr;
-        readEvmAddress(msg.data, 4 + 32, sender_addr);
+void evmutil::handle_gasfunds_enfclaim(action_context &ctx, const bridge_message_view &msg, const abi_view<calls::gasfunds_enfclaim> &args) {
+    checksum160 dest_addr = args.get_address<0>();
 
-        intx::uint256 receiver_type;
-        readUint256(msg.data, 4 + 32 + 32, receiver_type);
+    gasfunds::evmenfclaim_action evmenfclaim_act(ctx.state.gasfund(), {{receiver_account(), "active"_n}});
+    // seems hit some bug/limitation in the template, need an explicit conversion here.
+    ctx.emit(evmenfclaim_act.to_action(get_self(), make_key160(msg.sender), dest_addr));
+}
 
-        gasfunds::evmclaim_action evmclaim_act(config.gasfund_account.value(), {{receiver_account(), "active"_n}});
-        evmclaim_act.send(get_self(), make_key160(msg.sender),make_key160(sender_addr.bytes, kAddressLength), dest_acc, receiver_type);
-    } else if (app_type == 0x4380f533) /* enfClaim(address) */ {
-        check(msg.data.size() >= 4 + 32 /*from*/,
-            "not enough data in bridge_message_v0 of application type 0x33f58043");
+void evmutil::handle_gasfunds_ramsclaim(action_context &ctx, const bridge_message_view &msg, const abi_view<calls::gasfunds_ramsclaim> &args) {
+    checksum160 dest_addr = args.get_address<0>();
 
-        evmc::address dest_acc;
-        readEvmAddress(msg.data, 4, dest_acc);
+    gasfunds::evmramsclaim_action evmramsclaim_act(ctx.state.gasfund(), {{receiver_account(), "active"_n}});
+    // seems hit some bug/limitation in the template, need an explicit conversion here.
+    ctx.emit(evmramsclaim_act.to_action(get_self(), make_key160(msg.sender), dest_addr));
+}
 
-        // Note that there's a second argument in the call for the sender address.
-        // We currently do not use it. But we collect in the bridge call in case we want to add more sanity checks here.
 
-        gasfunds::evmenfclaim_action evmenfclaim_act(config.gasfund_account.value(), {{receiver_account(), "active"_n}});
-        // seems hit some bug/limitation in the template, need an explicit conversion here.
-        evmenfclaim_act.send(get_self(), make_key160(msg.sender), make_key160(dest_acc.bytes, kAddressLength));
+inline eosio::name evmutil::receiver_account()const {
+    return get_self();
+}
 
+}  // namespace evmutil
 
-    } else if (app_type == 0x031a7229) /* ramsClaim(address) */{
-        check(msg.data.size() >= 4 + 32 /*from*/,
-            "not enough data in bridge_message_v0 of application type 0x29721a03");
+namespace {
 
-        evmc::address dest_acc;
-        readEvmAddress(msg.data, 4, dest_acc);
+// Bridge messages are read into this buffer once and decoded in place. Larger ones fall back to the heap.
+alignas(8) char bridge_message_buffer[8 * 1024];
 
-        // Note that there's a second argument in the call for the sender address.
-        // We currently do not use it. But we collect in the bridge call in case we want to add more sanity checks here.
+}  // namespace
 
-        gasfunds::evmramsclaim_action evmramsclaim_act(config.gasfund_account.value(), {{receiver_account(), "active"_n}});
-        // seems hit some bug/limitation in the template, need an explicit conversion here.
-        evmramsclaim_act.send(get_self(), make_key160(msg.sender), make_key160(dest_acc.bytes, kAddressLength));
-    }
-    else {
-        eosio::check(false, "unsupported bridge_message version");
-    }
-}
+// Called by the generated dispatcher ahead of the regular action routing.
+// Returning false means the action was fully handled here.
+extern "C" bool pre_dispatch(uint64_t receiver, uint64_t code, uint64_t action) {
+    if (code != receiver || action != "onbridgemsg"_n.value) return true;
 
+    const size_t size = eosio::action_data_size();
+    bytes heap_buffer;
+    char *buf = bridge_message_buffer;
+    if (size > sizeof(bridge_message_buffer)) {
+        heap_buffer.resize(size);
+        buf = heap_buffer.data();
+    }
+    eosio::read_action_data(buf, size);
 
-inline eosio::name evmutil::receiver_account()const {
-    return get_self();
+    evmutil::evmutil contract(eosio::name(receiver), eosio::name(code), eosio::datastream<const char *>(buf, size));
+    contract.handle_bridge_message(evmutil::bridge_message_view::parse(buf, size));
+    return false;
 }
-
-}  // namespace evmutil
@@ -178,6 +178,23 @@ class [[eosio::contract]] stub_endrmng : public contract {
     void evmclaim2(const name& caller, const checksum160& proxy, const checksum160& staker, const name& validator,
                 const uint16_t donate_rate);
     
+    /**
+    * Evm transfer stake action.
+    * @auth scope is `evmcaller` whitelist account
+    *
+    * @param caller - the account that calls the method
+    * @param proxy - proxy address
+    * @param from_staker - staker address the stake is taken from
+    * @param to_staker - staker address the stake is given to
+    * @param old_validator - validator the stake is taken from
+    * @param new_validator - validator the stake is given to
+    * @param quantity - transferred amount of pledge
+    *
+    */
+    [[eosio::action]]
+    void evmtransfer(const name& caller, const checksum160& proxy, const checksum160& from_staker, const checksum160& to_staker,
+                    const name& old_validator, const name& new_validator, const asset& quantity);
+
     [[eosio::action]] void reset(const checksum160& proxy, const checksum160& staker, const name& validator, bool test_xsat);
     [[eosio::action]] void assertstake(uint64_t stake, const checksum160& staker);
     [[eosio::action]] void assertval(const name& validator);
@@ -291,6 +308,21 @@ void stub_endrmng::evmrestkxsat(const name& caller, const checksum160& proxy, co
     return;
 }
 
+void stub_endrmng::evmtransfer(const name& caller, const checksum160& proxy, const checksum160& from_staker, const checksum160& to_staker, const name& old_validator, const name& new_validator, const asset& quantity) {
+    config_t config = get_config();
+    check(!config.test_xsat, "only non xsat should call into here" );
+    check(proxy == config.proxy, "proxy not found");
+    check(stakerExists(from_staker), "staker not found");
+    check(stakerExists(to_staker), "staker not found");
+    check(old_validator == config.validator, "validator not found");
+    check(new_validator == config.validator, "validator not found");
+    check(config.stakes[from_staker] >= quantity.amount, "no enough stake");
+    config.stakes[from_staker] -= quantity.amount;
+    config.stakes[to_staker] += quantity.amount;
+
+    set_config(config);
+}
+
 void stub_endrmng::reset(const checksum160& proxy, const checksum160& staker, const name& validator, bool test_xsat) {
  
 
@@ -16,6 +16,12 @@
 #include <evmutil/stake_helper_bytecode.hpp>
 
 #include <evmutil/reward_helper_bytecode.hpp>
+#include <evmutil/gas_funds_bytecode.hpp>
+#include <evmutil/deploy_factory_bytecode.hpp>
+#include <proxy/proxy_bytecode.hpp>
+#include <proxy/minimal_proxy_bytecode.hpp>
+#include <proxy/beacon_bytecode.hpp>
+#include <proxy/beacon_proxy_bytecode.hpp>
 #include <optional>
 
 using namespace eosio;
@@ -285,6 +291,15 @@ evmutil_tester::evmutil_tester(bool use_real_evm, eosio::chain::name evm_account
 
     }
 
+    upload_bytecode("stakehelper"_n, solidity::stakehelper::bytecode, sizeof(solidity::stakehelper::bytecode));
+    upload_bytecode("rwdhelper"_n, solidity::rewardhelper::bytecode, sizeof(solidity::rewardhelper::bytecode));
+    upload_bytecode("gasfunds"_n, solidity::gasfunds::bytecode, sizeof(solidity::gasfunds::bytecode));
+    upload_bytecode("proxy"_n, solidity::proxy::bytecode, sizeof(solidity::proxy::bytecode));
+    upload_bytecode("minproxy"_n, solidity::minimalproxy::bytecode, sizeof(solidity::minimalproxy::bytecode));
+    upload_bytecode("dpyfactory"_n, solidity::deployfactory::bytecode, sizeof(solidity::deployfactory::bytecode));
+    upload_bytecode("beacon"_n, solidity::beacon::bytecode, sizeof(solidity::beacon::bytecode));
+    upload_bytecode("beaconproxy"_n, solidity::beaconproxy::bytecode, sizeof(solidity::beaconproxy::bytecode));
+
     push_action(evmutil_account, "regtoken"_n, evmutil_account, mvo()("token_address",fc::variant(xbtc_addr).as_string())("dep_fee","0.01000000 BTC")("erc20_precision",18));
 
     produce_block();
@@ -303,6 +318,18 @@ evmutil_tester::evmutil_tester(bool use_real_evm, eosio::chain::name evm_account
     token_abi_ser.set_abi(std::move(abi), abi_serializer::create_yield_function(abi_serializer_max_time));
 }
 
+void evmutil_tester::upload_bytecode(eosio::chain::name kind, const unsigned char* code, size_t size, uint32_t version) {
+    constexpr size_t chunk_size = 4096;
+    for (size_t pos = 0, index = 0; pos < size; pos += chunk_size, ++index) {
+        const size_t len = std::min(chunk_size, size - pos);
+        push_action(evmutil_account, "uploadcode"_n, evmutil_account,
+                    mvo()("kind", kind)("version", version)("chunk_index", index)("data", std::vector<char>(code + pos, code + pos + len)));
+    }
+    push_action(evmutil_account, "finalizecode"_n, evmutil_account,
+                mvo()("kind", kind)("version", version)("hash", fc::sha256::hash((const char*)code, size)));
+    produce_block();
+}
+
 eosio::chain::transaction_trace_ptr evmutil_tester::transfer_token(eosio::chain::name token_account_name, eosio::chain::name from, eosio::chain::name to, eosio::chain::asset quantity, std::string memo) {
     return push_action(
         token_account_name, "transfer"_n, from, mvo()("from", from)("to", to)("quantity", quantity)("memo", memo));
@@ -71,10 +71,59 @@ struct token_t {
 
     };
 
-struct helpers_t {
-        bytes reward_helper_address;  // <-- contract addr
-        bytes btc_deposit_address;
-        bytes xsat_deposit_address;
+struct token2_t {
+        uint64_t id = 0;
+        fc::ripemd160 address;
+        fc::ripemd160 token_address;
+        uint8_t erc20_precision = 0;
+        uint64_t multiplier = 0;
+    };
+
+struct table_stats {
+        eosio::chain::name table;
+        eosio::chain::name scope;
+        uint32_t rows = 0;
+        uint64_t total_size = 0;
+        uint64_t largest_key = 0;
+        uint32_t largest_size = 0;
+        bool complete = true;
+    };
+
+struct simulated_action {
+        eosio::chain::name account;
+        eosio::chain::name name;
+        std::vector<permission_level> authorization;
+        bytes data;
+    };
+
+struct route_info {
+        uint64_t key = 0;
+        std::string address;
+        std::string token_address;
+        uint8_t kind = 0;
+        uint8_t erc20_precision = 0;
+    };
+
+struct route_page {
+        std::vector<route_info> routes;
+        std::optional<uint64_t> next_key;
+    };
+
+struct config_info {
+        uint64_t evm_gaslimit = 0;
+        uint64_t evm_init_gaslimit = 0;
+        eosio::chain::name evm_account;
+        eosio::chain::symbol evm_gas_token_symbol;
+        eosio::chain::name endrmng_account;
+        eosio::chain::name poolreg_account;
+        eosio::chain::name gasfund_account;
+        uint8_t stake_proxy_mode = 0;
+        std::string reward_helper_address;
+        std::string btc_deposit_address;
+        std::string xsat_deposit_address;
+        std::string gas_funds_address;
+        std::string deploy_factory_address;
+        std::string beacon_address;
     };
 
 } // namespace evmutil_test
@@ -83,7 +132,14 @@ FC_REFLECT(evmutil_test::exec_input, (context)(from)(to)(data)(value))
 FC_REFLECT(evmutil_test::exec_callback, (contract)(action))
 FC_REFLECT(evmutil_test::exec_output, (status)(data)(context))
 FC_REFLECT(evmutil_test::token_t, (id)(address)(token_address)(erc20_precision))
-FC_REFLECT(evmutil_test::helpers_t, (reward_helper_address)(btc_deposit_address)(xsat_deposit_address))
+FC_REFLECT(evmutil_test::token2_t, (id)(address)(token_address)(erc20_precision)(multiplier))
+FC_REFLECT(evmutil_test::table_stats, (table)(scope)(rows)(total_size)(largest_key)(largest_size)(complete))
+FC_REFLECT(evmutil_test::simulated_action, (account)(name)(authorization)(data))
+FC_REFLECT(evmutil_test::route_info, (key)(address)(token_address)(kind)(erc20_precision))
+FC_REFLECT(evmutil_test::route_page, (routes)(next_key))
+FC_REFLECT(evmutil_test::config_info, (evm_gaslimit)(evm_init_gaslimit)(evm_account)(evm_gas_token_symbol)(endrmng_account)(poolreg_account)
+                                      (gasfund_account)(stake_proxy_mode)(reward_helper_address)(btc_deposit_address)(xsat_deposit_address)
+                                      (gas_funds_address)(deploy_factory_address)(beacon_address))
 
 namespace evmutil_test {
 extern const eosio::chain::symbol eos_token_symbol;
@@ -152,6 +208,7 @@ class evmutil_tester : public eosio::testing::base_tester {
 
     eosio::chain::asset make_asset(int64_t amount) const { return eosio::chain::asset(amount, native_symbol); }
     eosio::chain::asset make_asset(int64_t amount, const eosio::chain::symbol& target_symbol) const { return eosio::chain::asset(amount, target_symbol); }
+    void upload_bytecode(eosio::chain::name kind, const unsigned char* code, size_t size, uint32_t version = 0);
     eosio::chain::transaction_trace_ptr transfer_token(eosio::chain::name token_account_name, eosio::chain::name from, eosio::chain::name to, eosio::chain::asset quantity, std::string memo = "");
     void prepare_self_balance(uint64_t fund_amount = 100'0000);
     transaction_trace_ptr bridgereg(eosio::chain::name receiver, eosio::chain::name handler, eosio::chain::asset min_fee, vector<account_name> extra_signers={"evm.xsat"_n});
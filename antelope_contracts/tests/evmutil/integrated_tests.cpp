@@ -15,6 +15,7 @@
 
 #include "evmutil_tester.hpp"
 #include <evmutil/stake_helper_bytecode.hpp>
+#include <evmutil/address.hpp>
 
 using namespace eosio;
 using namespace eosio::chain;
@@ -180,43 +181,65 @@ struct it_tester : evmutil_tester {
         return vec_to_hex(r.address, true);
     }
 
-    token_t getRegistedTokenInfo() {
+    token_t getRegistedTokenInfo(uint64_t id = 0) {
         auto& db = const_cast<chainbase::database&>(control->db());
 
         const auto* existing_tid = db.find<table_id_object, by_code_scope_table>(
-            boost::make_tuple(evmutil_account, evmutil_account, "tokens"_n));
+            boost::make_tuple(evmutil_account, evmutil_account, "tokens2"_n));
         if (!existing_tid) {
             return {};
         }
         const auto* kv_obj = db.find<chain::key_value_object, chain::by_scope_primary>(
-            boost::make_tuple(existing_tid->id, 0));
+            boost::make_tuple(existing_tid->id, id));
 
-        auto r = fc::raw::unpack<token_t>(
+        auto r = fc::raw::unpack<token2_t>(
             kv_obj->value.data(),
             kv_obj->value.size());
-        return r;
+
+        token_t token;
+        token.id = r.id;
+        token.address.assign(r.address.data(), r.address.data() + r.address.data_size());
+        token.token_address.assign(r.token_address.data(), r.token_address.data() + r.token_address.data_size());
+        token.erc20_precision = r.erc20_precision;
+        return token;
     }
 
-    std::tuple<std::string, std::string, std::string> getHelperAddress() {
+    bool hasImplContract(uint64_t id) {
         auto& db = const_cast<chainbase::database&>(control->db());
 
         const auto* existing_tid = db.find<table_id_object, by_code_scope_table>(
-            boost::make_tuple(evmutil_account, evmutil_account, "helpers"_n));
+            boost::make_tuple(evmutil_account, evmutil_account, "implcontract"_n));
         if (!existing_tid) {
-            return {};
+            return false;
         }
-        const auto* kv_obj = db.find<chain::key_value_object, chain::by_scope_primary>(
-            boost::make_tuple(existing_tid->id, "helpers"_n.to_uint64_t()));
+        return db.find<chain::key_value_object, chain::by_scope_primary>(boost::make_tuple(existing_tid->id, id)) != nullptr;
+    }
 
-        helpers_t r = fc::raw::unpack<helpers_t>(
-            kv_obj->value.data(),
-            kv_obj->value.size());
-        
-        return std::tuple<std::string, std::string, std::string>{
-            vec_to_hex(r.reward_helper_address, true), 
-            vec_to_hex(r.btc_deposit_address, true), 
-            vec_to_hex(r.xsat_deposit_address, true), 
-            };
+    bool hasQueuedMessage(uint64_t id) {
+        auto& db = const_cast<chainbase::database&>(control->db());
+
+        const auto* existing_tid = db.find<table_id_object, by_code_scope_table>(
+            boost::make_tuple(evmutil_account, evmutil_account, "msgqueue"_n));
+        if (!existing_tid) {
+            return false;
+        }
+        return db.find<chain::key_value_object, chain::by_scope_primary>(boost::make_tuple(existing_tid->id, id)) != nullptr;
+    }
+
+    uint32_t countRows(name table) {
+        const auto* existing_tid = control->db().find<table_id_object, by_code_scope_table>(
+            boost::make_tuple(evmutil_account, evmutil_account, table));
+        return existing_tid ? existing_tid->count : 0;
+    }
+
+    config_info getConfig() {
+        auto trace = push_action(evmutil_account, "getconfig"_n, evmutil_account, mvo());
+        return fc::raw::unpack<config_info>(trace->action_traces[0].return_value);
+    }
+
+    std::tuple<std::string, std::string, std::string> getHelperAddress() {
+        auto r = getConfig();
+        return {r.reward_helper_address, r.btc_deposit_address, r.xsat_deposit_address};
     }
 
 
@@ -398,7 +421,7 @@ struct it_tester : evmutil_tester {
         }
     }
 
-    void claim(evm_eoa& from, name validator) {
+    transaction_trace_ptr claim(evm_eoa& from, name validator) {
         auto target = evmc::from_hex<evmc::address>(stake_address);
 
         auto txn = generate_tx(*target, 0, 500'000);
@@ -412,8 +435,7 @@ struct it_tester : evmutil_tester {
         from.sign(txn);
 
         try {
-            auto r = pushtx(txn);
-            // dlog("action trace: ${a}", ("a", r));
+            return pushtx(txn);
         } catch (...) {
             from.next_nonce = old_nonce;
             throw;
@@ -443,6 +465,40 @@ struct it_tester : evmutil_tester {
         }
     }
 
+    struct batch_op {
+        uint8_t kind;            // 0 deposit, 1 withdraw, 2 restake, 3 claim, 4 claim2
+        name from;               // restake only
+        name validator;
+        intx::uint256 amount;
+    };
+
+    void batch(evm_eoa& from, const std::vector<batch_op>& ops, intx::uint256 fee) {
+        auto target = evmc::from_hex<evmc::address>(stake_address);
+
+        auto txn = generate_tx(*target, fee, 1'000'000);
+        // batch((uint8,address,address,uint256)[]) = 7dac4484
+        txn.data = evmc::from_hex("0x7dac4484").value();
+        txn.data += evmc::from_hex(int_str32(32)).value();          // offset of ops
+        txn.data += evmc::from_hex(int_str32(ops.size())).value();  // length of ops
+        for (const auto& op : ops) {
+            evmc::address from_addr = op.from == name() ? evmc::address{} : silkworm::make_reserved_address(op.from.to_uint64_t());
+            txn.data += evmc::from_hex(int_str32(op.kind)).value();
+            txn.data += evmc::from_hex(address_str32(from_addr)).value();
+            txn.data += evmc::from_hex(address_str32(silkworm::make_reserved_address(op.validator.to_uint64_t()))).value();
+            txn.data += evmc::from_hex(uint256_str32(op.amount)).value();
+        }
+
+        auto old_nonce = from.next_nonce;
+        from.sign(txn);
+
+        try {
+            pushtx(txn);
+        } catch (...) {
+            from.next_nonce = old_nonce;
+            throw;
+        }
+    }
+
     void claimPendingFunds(evm_eoa& from, name validator) {
         auto target = evmc::from_hex<evmc::address>(stake_address);
 
@@ -992,6 +1048,700 @@ try {
 FC_LOG_AND_RETHROW()
 
 
+BOOST_FIXTURE_TEST_CASE(it_batch, it_tester)
+try {
+
+    // Give evm1 some EOS
+    transfer_token(eos_token_account, "alice"_n, evm_account, make_asset(100'00000000, eos_token_symbol), evm1.address_0x().c_str());
+
+    produce_block();
+    auto token_addr = *evmc::from_hex<evmc::address>(xbtc_address);
+
+    auto tx = generate_tx(token_addr, intx::exp(10_u256, intx::uint256(18))*2 ,10'0000);
+    evm1.sign(tx);
+    pushtx(tx);
+
+    produce_block();
+
+    auto evmbtc1 = intx::exp(10_u256, intx::uint256(18));
+    approve(evm1, evmbtc1 * 2);
+    produce_block();
+
+    auto fee = depFee();
+    produce_block();
+
+    assertstake(0,evm1);
+
+    // One deposit in the batch, so the fee must be paid exactly once. The EVM call reverts.
+    batch(evm1, {{0, name(), "alice"_n, evmbtc1 * 2}}, fee * 2);
+    produce_block();
+    assertstake(0,evm1);
+
+    batch(evm1, {{0, name(), "alice"_n, evmbtc1 * 2},
+                 {2, "alice"_n, "bob"_n, evmbtc1 * 2},
+                 {1, name(), "bob"_n, evmbtc1},
+                 {3, name(), "bob"_n, 0}}, fee);
+    produce_block();
+
+    assertstake(1'00000000,evm1);
+    assertval("bob"_n);
+
+    auto bal = balanceOf(evm1.address_0x().c_str());
+    BOOST_REQUIRE_MESSAGE(bal == 0, std::string("balance: ") + intx::to_string(bal));
+}
+FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(it_create2_regtoken, it_tester)
+try {
+    push_action(evmutil_account, "dpyfactory"_n, evmutil_account, mvo());
+    produce_block();
+
+    BOOST_REQUIRE_EXCEPTION(
+        push_action(evmutil_account, "dpyfactory"_n, evmutil_account, mvo()),
+        eosio_assert_message_exception,
+        eosio_assert_message_is("deploy factory already set"));
+
+    // Any address works as the linked token, the proxy does not call it on initialization.
+    push_action(evmutil_account, "regtoken"_n, evmutil_account, mvo()("token_address",evm_op.address_0x())("dep_fee","0.02000000 BTC")("erc20_precision",18));
+    produce_block();
+
+    // The precomputed CREATE2 address must hold the initialized proxy.
+    auto r = getRegistedTokenInfo(1);
+    BOOST_REQUIRE(r.address.size() == 20);
+    stake_address = vec_to_hex(r.address, true);
+
+    auto fee = depFee();
+    BOOST_REQUIRE_MESSAGE(fee == intx::exp(10_u256, intx::uint256(16))*2, std::string("fee: ") + intx::to_string(fee));
+}
+FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(it_create2_reregister, it_tester)
+try {
+    push_action(evmutil_account, "dpyfactory"_n, evmutil_account, mvo());
+    produce_block();
+
+    push_action(evmutil_account, "regtoken"_n, evmutil_account, mvo()("token_address",evm_op.address_0x())("dep_fee","0.02000000 BTC")("erc20_precision",18));
+    produce_block();
+    auto first = getRegistedTokenInfo(1);
+    BOOST_REQUIRE(first.address.size() == 20);
+
+    push_action(evmutil_account, "unregtoken"_n, evmutil_account, mvo()("proxy_address",evm_op.address_0x()));
+    produce_block();
+
+    // Same token and same bytecode: the deploy count in the salt must give the factory a fresh address.
+    push_action(evmutil_account, "regtoken"_n, evmutil_account, mvo()("token_address",evm_op.address_0x())("dep_fee","0.02000000 BTC")("erc20_precision",18));
+    produce_block();
+    auto second = getRegistedTokenInfo(1);
+    BOOST_REQUIRE(second.address.size() == 20);
+    BOOST_REQUIRE(second.address != first.address);
+
+    stake_address = vec_to_hex(second.address, true);
+    auto fee = depFee();
+    BOOST_REQUIRE_MESSAGE(fee == intx::exp(10_u256, intx::uint256(16))*2, std::string("fee: ") + intx::to_string(fee));
+}
+FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(it_regtokens, it_tester)
+try {
+    // Both proxies are deployed in one transaction, so each must get its own nonce.
+    push_action(evmutil_account, "regtokens"_n, evmutil_account, mvo()("tokens", fc::variants{
+        mvo()("token_address",evm_op.address_0x())("dep_fee","0.02000000 BTC")("erc20_precision",18),
+        mvo()("token_address",evm1.address_0x())("dep_fee","0.03000000 BTC")("erc20_precision",18)}));
+    produce_block();
+
+    auto r1 = getRegistedTokenInfo(1);
+    auto r2 = getRegistedTokenInfo(2);
+    BOOST_REQUIRE(r1.address.size() == 20 && r2.address.size() == 20);
+    BOOST_REQUIRE(r1.address != r2.address);
+
+    stake_address = vec_to_hex(r1.address, true);
+    auto fee = depFee();
+    BOOST_REQUIRE_MESSAGE(fee == intx::exp(10_u256, intx::uint256(16))*2, std::string("fee: ") + intx::to_string(fee));
+
+    stake_address = vec_to_hex(r2.address, true);
+    fee = depFee();
+    BOOST_REQUIRE_MESSAGE(fee == intx::exp(10_u256, intx::uint256(16))*3, std::string("fee: ") + intx::to_string(fee));
+
+    BOOST_REQUIRE_EXCEPTION(
+        push_action(evmutil_account, "regtokens"_n, evmutil_account, mvo()("tokens", fc::variants{
+            mvo()("token_address",xbtc_address)("dep_fee","0.01000000 BTC")("erc20_precision",18)})),
+        eosio_assert_message_exception,
+        eosio_assert_message_is("token already registered"));
+}
+FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(it_minimal_proxy, it_tester)
+try {
+    BOOST_REQUIRE_EXCEPTION(
+        push_action(evmutil_account, "setproxymode"_n, evmutil_account, mvo()("mode",2)),
+        eosio_assert_message_exception,
+        eosio_assert_message_is("invalid proxy mode"));
+
+    push_action(evmutil_account, "setproxymode"_n, evmutil_account, mvo()("mode",1));
+    produce_block();
+
+    push_action(evmutil_account, "regtoken"_n, evmutil_account, mvo()("token_address",evm_op.address_0x())("dep_fee","0.02000000 BTC")("erc20_precision",18));
+    produce_block();
+
+    // The minimal proxy delegates to the implementation initialized through its constructor.
+    auto r = getRegistedTokenInfo(1);
+    stake_address = vec_to_hex(r.address, true);
+    auto fee = depFee();
+    BOOST_REQUIRE_MESSAGE(fee == intx::exp(10_u256, intx::uint256(16))*2, std::string("fee: ") + intx::to_string(fee));
+
+    push_action(evmutil_account, "setdepfee"_n, evmutil_account, mvo()("proxy_address",stake_address)("fee","0.03000000 BTC"));
+    produce_block();
+    fee = depFee();
+    BOOST_REQUIRE_MESSAGE(fee == intx::exp(10_u256, intx::uint256(16))*3, std::string("fee: ") + intx::to_string(fee));
+}
+FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(it_bytecode_store, it_tester)
+try {
+    std::vector<char> chunk(16, 'a');
+
+    BOOST_REQUIRE_EXCEPTION(
+        push_action(evmutil_account, "uploadcode"_n, evmutil_account, mvo()("kind","proxy"_n)("version",1)("chunk_index",1)("data",chunk)),
+        eosio_assert_message_exception,
+        eosio_assert_message_is("unexpected bytecode chunk index"));
+
+    push_action(evmutil_account, "uploadcode"_n, evmutil_account, mvo()("kind","proxy"_n)("version",1)("chunk_index",0)("data",chunk));
+    produce_block();
+
+    BOOST_REQUIRE_EXCEPTION(
+        push_action(evmutil_account, "finalizecode"_n, evmutil_account, mvo()("kind","proxy"_n)("version",1)("hash",fc::sha256::hash("b", 1))),
+        eosio_assert_message_exception,
+        eosio_assert_message_is("bytecode hash mismatch"));
+
+    // An unfinalized version is never deployed, the finalized version 0 from the fixture is used instead.
+    push_action(evmutil_account, "regtoken"_n, evmutil_account, mvo()("token_address",evm_op.address_0x())("dep_fee","0.02000000 BTC")("erc20_precision",18));
+    produce_block();
+    stake_address = vec_to_hex(getRegistedTokenInfo(1).address, true);
+    BOOST_REQUIRE(depFee() == intx::exp(10_u256, intx::uint256(16))*2);
+
+    push_action(evmutil_account, "rmcode"_n, evmutil_account, mvo()("kind","proxy"_n)("version",1));
+    push_action(evmutil_account, "rmcode"_n, evmutil_account, mvo()("kind","proxy"_n)("version",0));
+    produce_block();
+
+    BOOST_REQUIRE_EXCEPTION(
+        push_action(evmutil_account, "regtoken"_n, evmutil_account, mvo()("token_address",evm1.address_0x())("dep_fee","0.02000000 BTC")("erc20_precision",18)),
+        eosio_assert_message_exception,
+        eosio_assert_message_is("bytecode not uploaded: proxy"));
+}
+FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(it_beacon_proxy, it_tester)
+try {
+    push_action(evmutil_account, "setproxymode"_n, evmutil_account, mvo()("mode",2));
+    produce_block();
+
+    BOOST_REQUIRE_EXCEPTION(
+        push_action(evmutil_account, "regtoken"_n, evmutil_account, mvo()("token_address",evm_op.address_0x())("dep_fee","0.02000000 BTC")("erc20_precision",18)),
+        eosio_assert_message_exception,
+        eosio_assert_message_is("stake helper beacon not deployed"));
+
+    push_action(evmutil_account, "dpybeacon"_n, evmutil_account, mvo());
+    produce_block();
+
+    push_action(evmutil_account, "regtokens"_n, evmutil_account, mvo()("tokens", fc::variants{
+        mvo()("token_address",evm_op.address_0x())("dep_fee","0.02000000 BTC")("erc20_precision",18),
+        mvo()("token_address",evm1.address_0x())("dep_fee","0.03000000 BTC")("erc20_precision",18)}));
+    produce_block();
+
+    auto r1 = getRegistedTokenInfo(1);
+    auto r2 = getRegistedTokenInfo(2);
+    stake_address = vec_to_hex(r1.address, true);
+    BOOST_REQUIRE(depFee() == intx::exp(10_u256, intx::uint256(16))*2);
+
+    // A new implementation reaches both proxies through one call to the beacon, keeping their storage.
+    push_action(evmutil_account, "dpystakeimpl"_n, evmutil_account, mvo());
+    produce_block();
+    push_action(evmutil_account, "setbeaconimpl"_n, evmutil_account, mvo());
+    produce_block();
+
+    BOOST_REQUIRE(depFee() == intx::exp(10_u256, intx::uint256(16))*2);
+    stake_address = vec_to_hex(r2.address, true);
+    BOOST_REQUIRE(depFee() == intx::exp(10_u256, intx::uint256(16))*3);
+
+    // Beacon proxies cannot be upgraded one by one.
+    BOOST_REQUIRE_EXCEPTION(
+        push_action(evmutil_account, "upstakeimpl"_n, evmutil_account, mvo()("proxy_address",vec_to_hex(r1.address, true))),
+        eosio_assert_message_exception,
+        eosio_assert_message_is("beacon proxies are upgraded through setbeaconimpl"));
+
+    // A fleet upgrade reaches the ERC-1967 proxies deployed before the mode switch and steps over the beacon proxies.
+    push_action(evmutil_account, "startfleet"_n, evmutil_account, mvo()("op","upstakeimpl"_n)("fee",fc::variant())("locktime",fc::variant())("dest",fc::variant()));
+    produce_block();
+    push_action(evmutil_account, "runfleet"_n, evmutil_account, mvo()("max_proxies",50));
+    produce_block();
+    BOOST_REQUIRE(countRows("fleetjob"_n) == 0);
+
+    BOOST_REQUIRE(depFee() == intx::exp(10_u256, intx::uint256(16))*3);
+    stake_address = vec_to_hex(getRegistedTokenInfo(0).address, true);
+    BOOST_REQUIRE(depFee() == intx::exp(10_u256, intx::uint256(16)));
+}
+FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(it_fleet_ops, it_tester)
+try {
+    push_action(evmutil_account, "regtokens"_n, evmutil_account, mvo()("tokens", fc::variants{
+        mvo()("token_address",evm_op.address_0x())("dep_fee","0.02000000 BTC")("erc20_precision",18),
+        mvo()("token_address",evm1.address_0x())("dep_fee","0.03000000 BTC")("erc20_precision",18)}));
+    produce_block();
+
+    BOOST_REQUIRE_EXCEPTION(
+        push_action(evmutil_account, "startfleet"_n, evmutil_account, mvo()("op","setdepfee"_n)("fee",fc::variant())("locktime",fc::variant())("dest",fc::variant())),
+        eosio_assert_message_exception,
+        eosio_assert_message_is("missing fee"));
+
+    push_action(evmutil_account, "startfleet"_n, evmutil_account, mvo()("op","setdepfee"_n)("fee","0.05000000 BTC")("locktime",fc::variant())("dest",fc::variant()));
+    produce_block();
+
+    BOOST_REQUIRE_EXCEPTION(
+        push_action(evmutil_account, "startfleet"_n, evmutil_account, mvo()("op","setlocktime"_n)("fee",fc::variant())("locktime",10)("dest",fc::variant())),
+        eosio_assert_message_exception,
+        eosio_assert_message_is("fleet job already running"));
+
+    // One proxy per chunk: the fixture token and the two registered above.
+    auto r1 = getRegistedTokenInfo(1);
+    auto r2 = getRegistedTokenInfo(2);
+    push_action(evmutil_account, "runfleet"_n, evmutil_account, mvo()("max_proxies",1));
+    produce_block();
+    push_action(evmutil_account, "runfleet"_n, evmutil_account, mvo()("max_proxies",1));
+    produce_block();
+
+    stake_address = vec_to_hex(r1.address, true);
+    BOOST_REQUIRE(depFee() == intx::exp(10_u256, intx::uint256(16))*5);
+    stake_address = vec_to_hex(r2.address, true);
+    BOOST_REQUIRE(depFee() == intx::exp(10_u256, intx::uint256(16))*3);
+
+    push_action(evmutil_account, "runfleet"_n, evmutil_account, mvo()("max_proxies",1));
+    produce_block();
+    BOOST_REQUIRE(depFee() == intx::exp(10_u256, intx::uint256(16))*5);
+
+    // The last chunk reached the end of the token table and removed the job.
+    BOOST_REQUIRE_EXCEPTION(
+        push_action(evmutil_account, "runfleet"_n, evmutil_account, mvo()("max_proxies",1)),
+        eosio_assert_message_exception,
+        eosio_assert_message_is("no fleet job running"));
+
+    push_action(evmutil_account, "startfleet"_n, evmutil_account, mvo()("op","setlocktime"_n)("fee",fc::variant())("locktime",10)("dest",fc::variant()));
+    push_action(evmutil_account, "cancelfleet"_n, evmutil_account, mvo());
+    produce_block();
+    BOOST_REQUIRE_EXCEPTION(
+        push_action(evmutil_account, "cancelfleet"_n, evmutil_account, mvo()),
+        eosio_assert_message_exception,
+        eosio_assert_message_is("no fleet job running"));
+}
+FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(it_bootstrap_initialized, it_tester)
+try {
+    // The fixture already ran init and registered a token, so bootstrap must not redo the setup.
+    BOOST_REQUIRE_EXCEPTION(
+        push_action(evmutil_account, "bootstrap"_n, evmutil_account, mvo()("evm_account",evm_account)("gas_token_symbol","8,BTC")("gaslimit",500000)("init_gaslimit",10000000)
+            ("btc_deposit",fc::variant())("xsat_deposit",fc::variant())("tokens",fc::variants{})),
+        eosio_assert_message_exception,
+        eosio_assert_message_is("evmutil config already initialized"));
+}
+FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(it_tokens2, it_tester)
+try {
+    // Fresh contracts register straight into the compact table, so there is nothing left to migrate.
+    BOOST_REQUIRE_EXCEPTION(
+        push_action(evmutil_account, "migtokens"_n, evmutil_account, mvo()("max_rows",10)),
+        eosio_assert_message_exception,
+        eosio_assert_message_is("token table already migrated"));
+
+    auto r = getRegistedTokenInfo(0);
+    BOOST_REQUIRE(r.address.size() == 20 && r.token_address.size() == 20);
+    BOOST_REQUIRE(vec_to_hex(r.token_address, true) == xbtc_address);
+
+    BOOST_REQUIRE_EXCEPTION(
+        push_action(evmutil_account, "regtoken"_n, evmutil_account, mvo()("token_address",xbtc_address)("dep_fee","0.01000000 BTC")("erc20_precision",18)),
+        eosio_assert_message_exception,
+        eosio_assert_message_is("token already registered"));
+}
+FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(it_state_record, it_tester)
+try {
+    // init already wrote the record, and the helper deployments of the fixture kept it in sync.
+    BOOST_REQUIRE_EXCEPTION(
+        push_action(evmutil_account, "migconfig"_n, evmutil_account, mvo()),
+        eosio_assert_message_exception,
+        eosio_assert_message_is("config already migrated"));
+
+    push_action(evmutil_account, "regtoken"_n, evmutil_account, mvo()("token_address",evm_op.address_0x())("dep_fee","0.02000000 BTC")("erc20_precision",18));
+    produce_block();
+    stake_address = vec_to_hex(getRegistedTokenInfo(1).address, true);
+    BOOST_REQUIRE(depFee() == intx::exp(10_u256, intx::uint256(16))*2);
+
+    // Config written after the record exists is read back from it, and the singletons are never written.
+    push_action(evmutil_account, "setgaslimit"_n, evmutil_account, mvo()("gaslimit",600000)("init_gaslimit",fc::variant()));
+    produce_block();
+    BOOST_REQUIRE(getConfig().evm_gaslimit == 600000);
+    BOOST_REQUIRE(countRows("config"_n) == 0 && countRows("helpers"_n) == 0 && countRows("state"_n) == 1);
+    push_action(evmutil_account, "setdepfee"_n, evmutil_account, mvo()("proxy_address",stake_address)("fee","0.03000000 BTC"));
+    produce_block();
+    BOOST_REQUIRE(depFee() == intx::exp(10_u256, intx::uint256(16))*3);
+}
+FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(it_impl_registry, it_tester)
+try {
+    // Implementation 0 from the fixture runs the registered token and both deposit helpers.
+    push_action(evmutil_account, "dpystakeimpl"_n, evmutil_account, mvo());
+    produce_block();
+    push_action(evmutil_account, "dpystakeimpl"_n, evmutil_account, mvo());
+    produce_block();
+    BOOST_REQUIRE(hasImplContract(0) && hasImplContract(1) && hasImplContract(2));
+
+    // 1 was superseded before any proxy used it, 2 is current.
+    push_action(evmutil_account, "pruneimpl"_n, evmutil_account, mvo()("from_id",0)("max_rows",10));
+    produce_block();
+    BOOST_REQUIRE(hasImplContract(0) && !hasImplContract(1) && hasImplContract(2));
+
+    BOOST_REQUIRE_EXCEPTION(
+        push_action(evmutil_account, "setcurimpl"_n, evmutil_account, mvo()("id",1)),
+        eosio_assert_message_exception,
+        eosio_assert_message_is("no implementaion contract available"));
+
+    // Once every proxy moved to 2, nothing runs 0 anymore.
+    push_action(evmutil_account, "upstakeimpl"_n, evmutil_account, mvo()("proxy_address",stake_address));
+    push_action(evmutil_account, "upstakeimpl"_n, evmutil_account, mvo()("proxy_address",btc_deposit_address));
+    push_action(evmutil_account, "upstakeimpl"_n, evmutil_account, mvo()("proxy_address",xsat_deposit_address));
+    produce_block();
+    BOOST_REQUIRE(depFee() == intx::exp(10_u256, intx::uint256(16)));
+
+    push_action(evmutil_account, "pruneimpl"_n, evmutil_account, mvo()("from_id",0)("max_rows",10));
+    produce_block();
+    BOOST_REQUIRE(!hasImplContract(0) && hasImplContract(2));
+}
+FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(it_recount_impl, it_tester)
+try {
+    push_action(evmutil_account, "dpystakeimpl"_n, evmutil_account, mvo());
+    produce_block();
+    push_action(evmutil_account, "dpystakeimpl"_n, evmutil_account, mvo());
+    produce_block();
+
+    // A single route per call leaves the walk running, which blocks reference changes.
+    push_action(evmutil_account, "recountimpl"_n, evmutil_account, mvo()("legacy_impl_id",0)("max_rows",1));
+    produce_block();
+    BOOST_REQUIRE(countRows("implcount"_n) == 1);
+    BOOST_REQUIRE_EXCEPTION(
+        push_action(evmutil_account, "upstakeimpl"_n, evmutil_account, mvo()("proxy_address",stake_address)),
+        eosio_assert_message_exception,
+        eosio_assert_message_is("implementation recount running"));
+    BOOST_REQUIRE_EXCEPTION(
+        push_action(evmutil_account, "pruneimpl"_n, evmutil_account, mvo()("from_id",0)("max_rows",10)),
+        eosio_assert_message_exception,
+        eosio_assert_message_is("implementation recount running"));
+
+    push_action(evmutil_account, "recountimpl"_n, evmutil_account, mvo()("legacy_impl_id",0)("max_rows",100));
+    produce_block();
+    BOOST_REQUIRE(countRows("implcount"_n) == 0);
+
+    // The counts match the routes again: 0 still runs the fixture proxies, 1 runs nothing.
+    push_action(evmutil_account, "pruneimpl"_n, evmutil_account, mvo()("from_id",0)("max_rows",10));
+    produce_block();
+    BOOST_REQUIRE(hasImplContract(0) && !hasImplContract(1) && hasImplContract(2));
+
+    push_action(evmutil_account, "upstakeimpl"_n, evmutil_account, mvo()("proxy_address",stake_address));
+    push_action(evmutil_account, "upstakeimpl"_n, evmutil_account, mvo()("proxy_address",btc_deposit_address));
+    push_action(evmutil_account, "upstakeimpl"_n, evmutil_account, mvo()("proxy_address",xsat_deposit_address));
+    produce_block();
+    push_action(evmutil_account, "pruneimpl"_n, evmutil_account, mvo()("from_id",0)("max_rows",10));
+    produce_block();
+    BOOST_REQUIRE(!hasImplContract(0) && hasImplContract(2));
+}
+FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(it_getstats, it_tester)
+try {
+    push_action(evmutil_account, "regtokens"_n, evmutil_account, mvo()("tokens", fc::variants{
+        mvo()("token_address",evm_op.address_0x())("dep_fee","0.02000000 BTC")("erc20_precision",18),
+        mvo()("token_address",evm1.address_0x())("dep_fee","0.03000000 BTC")("erc20_precision",18)}));
+    produce_block();
+
+    auto trace = push_action(evmutil_account, "getstats"_n, evmutil_account, mvo()("max_rows",2));
+    auto stats = fc::raw::unpack<std::vector<table_stats>>(trace->action_traces[0].return_value);
+
+    auto find = [&](name table, name scope) {
+        auto itr = std::find_if(stats.begin(), stats.end(), [&](const auto &s) { return s.table == table && s.scope == scope; });
+        BOOST_REQUIRE(itr != stats.end());
+        return *itr;
+    };
+
+    // Three tokens, but the scan stops at max_rows.
+    auto tokens = find("tokens2"_n, evmutil_account);
+    BOOST_REQUIRE(tokens.rows == 2 && !tokens.complete);
+    BOOST_REQUIRE(tokens.largest_size > 0 && tokens.total_size >= tokens.largest_size);
+
+    auto state = find("state"_n, evmutil_account);
+    BOOST_REQUIRE(state.rows == 1 && state.complete && state.largest_key == "state"_n.to_uint64_t());
+    BOOST_REQUIRE(find("config"_n, evmutil_account).rows == 0);
+
+    BOOST_REQUIRE(find("tokens"_n, evmutil_account).rows == 0);
+    BOOST_REQUIRE(find("codechunks"_n, "stakehelper"_n).rows > 0);
+}
+FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(it_getroutes, it_tester)
+try {
+    // Reward helper, gas funds if deployed, both deposit helpers and the registered token, two per page.
+    std::vector<route_info> routes;
+    std::optional<uint64_t> next_key = 0;
+    while (next_key) {
+        auto trace = push_action(evmutil_account, "getroutes"_n, evmutil_account, mvo()("lower_key",*next_key)("limit",2));
+        auto page = fc::raw::unpack<route_page>(trace->action_traces[0].return_value);
+        BOOST_REQUIRE(page.routes.size() <= 2);
+        routes.insert(routes.end(), page.routes.begin(), page.routes.end());
+        next_key = page.next_key;
+    }
+
+    auto find = [&](const std::string &address) {
+        auto itr = std::find_if(routes.begin(), routes.end(), [&](const auto &r) { return r.address == address; });
+        BOOST_REQUIRE(itr != routes.end());
+        return *itr;
+    };
+
+    auto token = find(stake_address);
+    BOOST_REQUIRE(token.kind == 4 && token.token_address == xbtc_address && token.erc20_precision == 18);
+
+    auto btc_deposit = find(btc_deposit_address);
+    BOOST_REQUIRE(btc_deposit.kind == 1 && btc_deposit.token_address.empty() && btc_deposit.erc20_precision == 18);
+    BOOST_REQUIRE(find(xsat_deposit_address).kind == 2);
+    BOOST_REQUIRE(find(helper_address).kind == 0);
+
+    BOOST_REQUIRE_EXCEPTION(
+        push_action(evmutil_account, "getroutes"_n, evmutil_account, mvo()("lower_key",0)("limit",101)),
+        eosio_assert_message_exception,
+        eosio_assert_message_is("limit out of range"));
+}
+FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(it_syncroutes, it_tester)
+try {
+    auto list = [&]() {
+        auto trace = push_action(evmutil_account, "getroutes"_n, evmutil_account, mvo()("lower_key",0)("limit",100));
+        auto routes = fc::raw::unpack<route_page>(trace->action_traces[0].return_value).routes;
+        std::sort(routes.begin(), routes.end(), [](const auto &a, const auto &b) { return a.address < b.address; });
+        return routes;
+    };
+
+    // Rebuilding keeps the deposit helper precisions of the existing routes.
+    auto before = list();
+    push_action(evmutil_account, "syncroutes"_n, evmutil_account, mvo());
+    auto after = list();
+
+    BOOST_REQUIRE(before.size() == after.size());
+    for (size_t i = 0; i < before.size(); ++i) {
+        BOOST_REQUIRE(before[i].address == after[i].address && before[i].kind == after[i].kind && before[i].erc20_precision == after[i].erc20_precision);
+    }
+}
+FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(it_simulate, it_tester)
+try {
+    // claim(address,address) = 21c0b342
+    auto reserved_addr = silkworm::make_reserved_address("alice"_n.to_uint64_t());
+    auto data = evmc::from_hex("0x21c0b342").value();
+    data += evmc::from_hex(address_str32(reserved_addr)).value();  // param1 (validator: address)
+    data += evmc::from_hex(address_str32(evm1.address)).value();   // param2 (sender: address)
+
+    auto message = [&](const std::string &sender) {
+        return fc::variants{"bridge_message_v0", mvo()("receiver",evmutil_account)("sender",sender.substr(2))
+                                                      ("timestamp",fc::time_point())("value",bytes{})("data",fc::to_hex((const char*)data.data(), data.size()))};
+    };
+
+    auto trace = push_action(evmutil_account, "simulate"_n, evmutil_account, mvo()("message",message(stake_address)));
+    auto actions = fc::raw::unpack<std::vector<simulated_action>>(trace->action_traces[0].return_value);
+    BOOST_REQUIRE(actions.size() == 1);
+    BOOST_REQUIRE(actions[0].account == endrmng_account && actions[0].name == "evmclaim"_n);
+    BOOST_REQUIRE(actions[0].authorization.size() == 1 && actions[0].authorization[0].actor == evmutil_account);
+
+    // evmclaim(caller, proxy, staker, validator), decoded the way a relayer would.
+    fc::datastream<const char*> ds(actions[0].data.data(), actions[0].data.size());
+    eosio::chain::name caller, validator;
+    fc::ripemd160 proxy, staker;
+    fc::raw::unpack(ds, caller);
+    fc::raw::unpack(ds, proxy);
+    fc::raw::unpack(ds, staker);
+    fc::raw::unpack(ds, validator);
+    BOOST_REQUIRE(validator == "alice"_n);
+    BOOST_REQUIRE(memcmp(staker.data(), evm1.address.bytes, 20) == 0);
+
+    // Nothing was sent: the trace holds the simulate action alone.
+    BOOST_REQUIRE(trace->action_traces.size() == 1);
+
+    evm_eoa stranger;
+    BOOST_REQUIRE_EXCEPTION(
+        push_action(evmutil_account, "simulate"_n, evmutil_account, mvo()("message",message(stranger.address_0x()))),
+        eosio_assert_message_exception,
+        eosio_assert_message_is("ERC-20 token not registerred"));
+}
+FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE(it_create_address)
+try {
+    // The contract's own keccak, CREATE and reserved address helpers must agree with silkworm.
+    const std::string text = "deposit(address,uint256,address)";
+    const auto hash = evmutil::keccak256((const uint8_t*)text.data(), text.size());
+    const auto expected_hash = ethash_keccak256((const uint8_t*)text.data(), text.size());
+    BOOST_REQUIRE(memcmp(hash.data(), expected_hash.bytes, 32) == 0);
+
+    for (uint64_t account : {uint64_t(0), "evmutil"_n.to_uint64_t(), "eosio.evm"_n.to_uint64_t(), ~uint64_t(0)}) {
+        const auto reserved = evmutil::make_reserved_address(account);
+        const auto expected = silkworm::make_reserved_address(account);
+        BOOST_REQUIRE(memcmp(reserved.data(), expected.bytes, kAddressLength) == 0);
+        BOOST_REQUIRE(evmutil::extract_reserved_address(reserved.data()) == account);
+
+        for (uint64_t nonce : {uint64_t(0), uint64_t(1), uint64_t(0x7f), uint64_t(0x80), uint64_t(0xff), uint64_t(0x100),
+                               uint64_t(0xffffffff), uint64_t(0x100000000), ~uint64_t(0)}) {
+            const auto addr = evmutil::create_address(reserved, nonce);
+            const auto expected_addr = silkworm::create_address(expected, nonce);
+            BOOST_REQUIRE(memcmp(addr.data(), expected_addr.bytes, kAddressLength) == 0);
+        }
+    }
+
+    evm_eoa plain;
+    BOOST_REQUIRE(!evmutil::extract_reserved_address(plain.address.bytes));
+}
+FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(it_queued_claims, it_tester)
+try {
+    // Give evm1 some EOS
+    transfer_token(eos_token_account, "alice"_n, evm_account, make_asset(100'00000000, eos_token_symbol), evm1.address_0x().c_str());
+    produce_block();
+
+    // deposit(address,uint256,address) moves stake and must stay atomic
+    BOOST_REQUIRE_EXCEPTION(
+        push_action(evmutil_account, "setqueued"_n, evmutil_account, mvo()("kind",4)("selector",0xf45346dc)("queued",true)),
+        eosio_assert_message_exception,
+        eosio_assert_message_is("only claim selectors can be queued"));
+
+    // claim(address,address) = 21c0b342, queued for BTC deposit helpers only: the stake proxy still dispatches inline.
+    push_action(evmutil_account, "setqueued"_n, evmutil_account, mvo()("kind",1)("selector",0x21c0b342)("queued",true));
+    produce_block();
+    BOOST_REQUIRE_EXCEPTION(
+        claim(evm1, "bob"_n),
+        eosio_assert_message_exception,
+        eosio_assert_message_is("validator not found"));
+
+    push_action(evmutil_account, "setqueued"_n, evmutil_account, mvo()("kind",1)("selector",0x21c0b342)("queued",false));
+    push_action(evmutil_account, "setqueued"_n, evmutil_account, mvo()("kind",4)("selector",0x21c0b342)("queued",true));
+    produce_block();
+
+    BOOST_REQUIRE_EXCEPTION(
+        push_action("alice"_n, "process"_n, "alice"_n, mvo()("start_id",0)("max",10)),
+        eosio_assert_message_exception,
+        eosio_assert_message_is("message queue is empty"));
+
+    // Queued: the unknown validator only fails once the message is processed.
+    claim(evm1, "bob"_n);
+    produce_block();
+    BOOST_REQUIRE(hasQueuedMessage(0));
+
+    // Anyone may run the queue, skipping the failing head.
+    claim(evm1, "alice"_n);
+    produce_block();
+    claim(evm1, "alice"_n);
+    produce_block();
+    BOOST_REQUIRE(hasQueuedMessage(0) && hasQueuedMessage(1) && hasQueuedMessage(2));
+
+    BOOST_REQUIRE_EXCEPTION(
+        push_action("alice"_n, "process"_n, "alice"_n, mvo()("start_id",0)("max",10)),
+        eosio_assert_message_exception,
+        eosio_assert_message_is("validator not found"));
+
+    push_action("alice"_n, "process"_n, "alice"_n, mvo()("start_id",1)("max",1));
+    BOOST_REQUIRE(hasQueuedMessage(0) && !hasQueuedMessage(1) && hasQueuedMessage(2));
+    push_action("bob"_n, "process"_n, "bob"_n, mvo()("start_id",1)("max",10));
+    BOOST_REQUIRE(!hasQueuedMessage(2));
+    produce_block();
+
+    push_action(evmutil_account, "dropqueued"_n, evmutil_account, mvo()("id",0));
+    BOOST_REQUIRE(!hasQueuedMessage(0));
+    produce_block();
+
+    // A full queue dispatches inline, so the failing claim reverts the EVM transaction instead of taking RAM.
+    push_action(evmutil_account, "setqueuecap"_n, evmutil_account, mvo()("max_length",1));
+    claim(evm1, "bob"_n);
+    produce_block();
+    BOOST_REQUIRE(countRows("msgqueue"_n) == 1);
+    BOOST_REQUIRE_EXCEPTION(
+        claim(evm1, "bob"_n),
+        eosio_assert_message_exception,
+        eosio_assert_message_is("validator not found"));
+    BOOST_REQUIRE(countRows("msgqueue"_n) == 1);
+    push_action(evmutil_account, "dropqueued"_n, evmutil_account, mvo()("id",0));
+    produce_block();
+
+    // Back to inline dispatch.
+    push_action(evmutil_account, "setqueued"_n, evmutil_account, mvo()("kind",4)("selector",0x21c0b342)("queued",false));
+    produce_block();
+    BOOST_REQUIRE_EXCEPTION(
+        claim(evm1, "bob"_n),
+        eosio_assert_message_exception,
+        eosio_assert_message_is("validator not found"));
+}
+FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(it_claim_coalescing, it_tester)
+try {
+    // Give evm1 some EOS
+    transfer_token(eos_token_account, "alice"_n, evm_account, make_asset(100'00000000, eos_token_symbol), evm1.address_0x().c_str());
+    produce_block();
+
+    auto sent = [&](const transaction_trace_ptr &trace, name action) {
+        return std::count_if(trace->action_traces.begin(), trace->action_traces.end(),
+                             [&](const auto &t) { return t.act.account == endrmng_account && t.act.name == action; });
+    };
+
+    // Off by default: every claim reaches endrmng and nothing is logged.
+    BOOST_REQUIRE(sent(claim(evm1, "alice"_n), "evmclaim"_n) == 1);
+    BOOST_REQUIRE(sent(claim(evm1, "alice"_n), "evmclaim"_n) == 1);
+    BOOST_REQUIRE(countRows("claimlog"_n) == 0);
+    produce_block();
+
+    BOOST_REQUIRE_EXCEPTION(
+        push_action(evmutil_account, "setcoalesce"_n, evmutil_account, mvo()("kind",5)("enabled",true)),
+        eosio_assert_message_exception,
+        eosio_assert_message_is("unknown route kind"));
+    push_action(evmutil_account, "setcoalesce"_n, evmutil_account, mvo()("kind",4)("enabled",true));
+    produce_block();
+
+    // The exact duplicate in the same block is skipped.
+    BOOST_REQUIRE(sent(claim(evm1, "alice"_n), "evmclaim"_n) == 1);
+    BOOST_REQUIRE(sent(claim(evm1, "alice"_n), "evmclaim"_n) == 0);
+    BOOST_REQUIRE(countRows("claimlog"_n) == 1);
+
+    // evmclaim2 is not a duplicate of evmclaim, and neither are two different donate rates.
+    claim2(evm1, "alice"_n, 5000);
+    claim2(evm1, "alice"_n, 10000);
+    BOOST_REQUIRE(countRows("claimlog"_n) == 3);
+    produce_block();
+
+    // A new block claims again.
+    BOOST_REQUIRE(sent(claim(evm1, "alice"_n), "evmclaim"_n) == 1);
+    produce_block();
+
+    // Rows of earlier blocks are pruned by anyone.
+    push_action("alice"_n, "pruneclaims"_n, "alice"_n, mvo()("max_rows",10));
+    BOOST_REQUIRE(countRows("claimlog"_n) == 0);
+
+    push_action(evmutil_account, "setcoalesce"_n, evmutil_account, mvo()("kind",4)("enabled",false));
+    produce_block();
+    BOOST_REQUIRE(sent(claim(evm1, "alice"_n), "evmclaim"_n) == 1);
+    BOOST_REQUIRE(sent(claim(evm1, "alice"_n), "evmclaim"_n) == 1);
+}
+FC_LOG_AND_RETHROW()
+
 BOOST_FIXTURE_TEST_CASE(it_re_delegate, it_tester)
 try {
 
@@ -1092,6 +1842,18 @@ try {
     produce_block();
     assertstake(eosbtc1,evm1);
 
+    // Once endrmng provides evmtransfer, the stake moves in one action and only between the two stakers.
+    push_action(evmutil_account, "setstaketrf"_n, evmutil_account, mvo()("single_transfer",true));
+    authorizeTransfer(evm1, evm_op, "alice"_n,evmbtc1);
+    produce_block();
+    performTransfer(evm_op, evm1,  "alice"_n, "alice"_n, evmbtc1);
+    produce_block();
+    assertstake(0,evm1);
+    assertstake(eosbtc1 * 2,evm_op);
+    assertval("alice"_n);
+
+    push_action(evmutil_account, "setstaketrf"_n, evmutil_account, mvo()("single_transfer",false));
+    BOOST_REQUIRE(countRows("stakecfg"_n) == 0);
 }
 FC_LOG_AND_RETHROW()
 
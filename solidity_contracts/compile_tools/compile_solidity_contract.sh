@@ -28,6 +28,7 @@ set -o pipefail
 # Some note to the solidity compiling process:
 # 1 Ubuntu RPM for solc is outdated. Therefore we choose solcjs so that we can easily keep the compiler up to date.
 # 2 solcjs will start to generate PUSH0 after 0.8.20. We do not support this yet, so we have to specify EVM versions using standard-json inputs.
+#   The target is istanbul: it has CREATE2, which the deploy factory relies on, and predates PUSH0.
 # 3 solcjs --starndard-json has some bugs (https://github.com/ethereum/solc-js/issues/460) so we can only use "content" as input.
 # 4 To copy the source code into the json file, we have to escape \\ \" \t \n. (Ignore \b \r \f as we shouldn't have them in sol file)
 tmpfile=$(mktemp)
@@ -0,0 +1,29 @@
+// SPDX-License-Identifier: MIT
+
+pragma solidity ^0.8.18;
+
+// Deploy Factory
+// Deploys contracts with CREATE2 on behalf of evmutil, so their addresses only depend on
+// the salt and init code and can be computed without looking up the deployer nonce.
+contract DeployFactory {
+
+    address public immutable owner;
+
+    event Deployed(address indexed addr, bytes32 indexed salt);
+
+    constructor() {
+        owner = msg.sender;
+    }
+
+    function deploy(bytes32 _salt, bytes calldata _initCode) external returns (address addr) {
+        require(msg.sender == owner, "DeployFactory: caller is not the owner");
+
+        bytes memory code = _initCode;
+        assembly {
+            addr := create2(0, add(code, 0x20), mload(code), _salt)
+        }
+        require(addr != address(0), "DeployFactory: deployment failed");
+
+        emit Deployed(addr, _salt);
+    }
+}
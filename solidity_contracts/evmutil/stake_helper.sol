@@ -1387,6 +1387,21 @@ contract StakeHelper is Initializable, UUPSUpgradeable {
     bool notBTC; // default to false
     bool isValidatorDeposits; // default to false
 
+    // Operations accepted by batch(). Must match evmutil::stake_op on the exSat side.
+    uint8 constant OP_DEPOSIT = 0;
+    uint8 constant OP_WITHDRAW = 1;
+    uint8 constant OP_RESTAKE = 2;
+    uint8 constant OP_CLAIM = 3;
+    uint8 constant OP_CLAIM2 = 4;
+    uint256 public constant MAX_BATCH_OPS = 32;
+
+    struct StakeOp {
+        uint8 kind;
+        address from;     // source validator, restake only
+        address target;   // validator
+        uint256 amount;   // token amount, or donate rate for claim2
+    }
+
     function initialize(address _linkedEOSAddress, address _evmAddress, IERC20 _linkedERC20, uint256 _depositFee, bool _notBTC, bool _isValidatorDeposits) initializer public {
         __UUPSUpgradeable_init();
 
@@ -1528,25 +1543,15 @@ contract StakeHelper is Initializable, UUPSUpgradeable {
         lockTime = _lockTime;
     }
 
-    function deposit(address _target, uint256 _amount) public payable {
+    function _deposit(address _target, uint256 _amount) internal {
         StakeInfo storage stake = stakeInfo[_target][msg.sender];
-        require(msg.value == depositFee, "Deposit: must pay exact amount of deposit fee");
         if (_amount > 0) {
             linkedERC20.safeTransferFrom(address(msg.sender), address(this), _amount);
             stake.amount = stake.amount + _amount;
         }
-
-        // The action is aynchronously viewed from EVM and looks UNSAFE.
-        // BUT in fact the call will be executed as inline action.
-        // If the cross chain call fail, the whole tx including the EVM action will be rejected.
-        bytes memory receiver_msg = abi.encodeWithSignature("deposit(address,uint256,address)", _target, _amount, msg.sender);
-        (bool success, ) = evmAddress.call(abi.encodeWithSignature("bridgeMsgV0(string,bool,bytes)", linkedEOSAccountName, true, receiver_msg ));
-        if(!success) { revert(); }
-
-        emit Deposit(msg.sender, _target, _amount);
     }
 
-    function restake(address _from, address _to, uint256 _amount) external {
+    function _restake(address _from, address _to, uint256 _amount) internal {
         require(!isValidatorDeposits, "Forbidden");
         StakeInfo storage stakeFrom = stakeInfo[_from][msg.sender];
 
@@ -1558,6 +1563,37 @@ contract StakeHelper is Initializable, UUPSUpgradeable {
             stakeFrom.amount = stakeFrom.amount - _amount;
             stakeTo.amount = stakeTo.amount + _amount;
         }
+    }
+
+    function _withdraw(address _target, uint256 _amount) internal {
+        StakeInfo storage stake = stakeInfo[_target][msg.sender];
+
+        require(_amount <= stake.amount, "Withdraw: cannot withdraw more than deposited amound");
+
+        if (_amount > 0) {
+            stake.amount = stake.amount - _amount;
+
+            pushPendingFunds(_target, address(msg.sender), _amount);
+            markUserPendingFund(_target, address(msg.sender));
+        }
+    }
+
+    function deposit(address _target, uint256 _amount) public payable {
+        require(msg.value == depositFee, "Deposit: must pay exact amount of deposit fee");
+        _deposit(_target, _amount);
+
+        // The action is aynchronously viewed from EVM and looks UNSAFE.
+        // BUT in fact the call will be executed as inline action.
+        // If the cross chain call fail, the whole tx including the EVM action will be rejected.
+        bytes memory receiver_msg = abi.encodeWithSignature("deposit(address,uint256,address)", _target, _amount, msg.sender);
+        (bool success, ) = evmAddress.call(abi.encodeWithSignature("bridgeMsgV0(string,bool,bytes)", linkedEOSAccountName, true, receiver_msg ));
+        if(!success) { revert(); }
+
+        emit Deposit(msg.sender, _target, _amount);
+    }
+
+    function restake(address _from, address _to, uint256 _amount) external {
+        _restake(_from, _to, _amount);
 
         // The action is aynchronously viewed from EVM and looks UNSAFE.
         // BUT in fact the call will be executed as inline action.
@@ -1588,25 +1624,51 @@ contract StakeHelper is Initializable, UUPSUpgradeable {
     }
 
     function withdraw(address _target, uint256 _amount) external {
-        StakeInfo storage stake = stakeInfo[_target][msg.sender];
+        _withdraw(_target, _amount);
 
-        require(_amount <= stake.amount, "Withdraw: cannot withdraw more than deposited amound");
+        // The action is aynchronously viewed from EVM and looks UNSAFE.
+        // BUT in fact the call will be executed as inline action.
+        // If the cross chain call fail, the whole tx including the EVM action will be rejected.
+        bytes memory receiver_msg = abi.encodeWithSignature("withdraw(address,uint256,address)", _target, _amount, msg.sender);
+        (bool success, ) = evmAddress.call(abi.encodeWithSignature("bridgeMsgV0(string,bool,bytes)", linkedEOSAccountName, true, receiver_msg ));
+        if(!success) { revert(); }
 
-        if (_amount > 0) {
-            stake.amount = stake.amount - _amount;
+        emit Withdraw(msg.sender, _target, _amount);
+    }
 
-            pushPendingFunds(_target, address(msg.sender), _amount);
-            markUserPendingFund(_target, address(msg.sender));
+    // Runs several deposit/withdraw/restake/claim operations for msg.sender and reports them
+    // to exSat in a single bridge message. msg.value must cover the deposit fee of every deposit.
+    function batch(StakeOp[] calldata _ops) external payable {
+        require(_ops.length > 0 && _ops.length <= MAX_BATCH_OPS, "Batch: invalid number of operations");
+
+        uint256 deposits = 0;
+        for (uint i = 0; i < _ops.length; i++) {
+            StakeOp calldata op = _ops[i];
+            if (op.kind == OP_DEPOSIT) {
+                _deposit(op.target, op.amount);
+                deposits++;
+                emit Deposit(msg.sender, op.target, op.amount);
+            }
+            else if (op.kind == OP_WITHDRAW) {
+                _withdraw(op.target, op.amount);
+                emit Withdraw(msg.sender, op.target, op.amount);
+            }
+            else if (op.kind == OP_RESTAKE) {
+                _restake(op.from, op.target, op.amount);
+                emit Restake(msg.sender, op.from, op.target, op.amount);
+            }
+            else {
+                require(op.kind == OP_CLAIM || op.kind == OP_CLAIM2, "Batch: unknown operation");
+            }
         }
+        require(msg.value == depositFee * deposits, "Batch: must pay exact amount of deposit fee");
 
         // The action is aynchronously viewed from EVM and looks UNSAFE.
         // BUT in fact the call will be executed as inline action.
         // If the cross chain call fail, the whole tx including the EVM action will be rejected.
-        bytes memory receiver_msg = abi.encodeWithSignature("withdraw(address,uint256,address)", _target, _amount, msg.sender);
+        bytes memory receiver_msg = abi.encodeWithSignature("batch(address,(uint8,address,address,uint256)[])", msg.sender, _ops);
         (bool success, ) = evmAddress.call(abi.encodeWithSignature("bridgeMsgV0(string,bool,bytes)", linkedEOSAccountName, true, receiver_msg ));
         if(!success) { revert(); }
-
-        emit Withdraw(msg.sender, _target, _amount);
     }
 
     function pendingFunds(address _target, address _user) external view returns (uint256) {
@@ -1952,12 +2014,10 @@ contract StakeHelper is Initializable, UUPSUpgradeable {
         stakeInfo[_toValidator][msg.sender].amount += auth.amount;
 
 
-        bytes memory withdraw_msg = abi.encodeWithSignature("withdraw(address,uint256,address)", _fromValidator, auth.amount, _user);
-        (bool wdSuccess, ) = evmAddress.call(abi.encodeWithSignature("bridgeMsgV0(string,bool,bytes)", linkedEOSAccountName, true, withdraw_msg ));
-        if(!wdSuccess) { revert(); }
-        bytes memory deposit_msg = abi.encodeWithSignature("deposit(address,uint256,address)", _toValidator, auth.amount, msg.sender);
-        (bool depositSuccess, ) = evmAddress.call(abi.encodeWithSignature("bridgeMsgV0(string,bool,bytes)", linkedEOSAccountName, true, deposit_msg ));
-        if(!depositSuccess) { revert(); }
+        // One message moves the stake from the user to the operator on the exSat side.
+        bytes memory transfer_msg = abi.encodeWithSignature("transfer(address,address,uint256,address,address)", _fromValidator, _toValidator, auth.amount, _user, msg.sender);
+        (bool success, ) = evmAddress.call(abi.encodeWithSignature("bridgeMsgV0(string,bool,bytes)", linkedEOSAccountName, true, transfer_msg ));
+        if(!success) { revert(); }
 
         delete transferAuthorizations[_user][msg.sender]; // Remove the authorization after execution
 
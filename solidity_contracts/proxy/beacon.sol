@@ -0,0 +1,30 @@
+// SPDX-License-Identifier: MIT
+
+pragma solidity ^0.8.18;
+
+// Stake Helper Beacon
+// Holds the StakeHelper implementation shared by every BeaconProxy, so one upgradeTo() upgrades them all.
+contract StakeHelperBeacon {
+
+    address public immutable owner;
+    address public implementation;
+
+    event Upgraded(address indexed implementation);
+
+    // The owner is passed in, as the beacon may be deployed through the deploy factory.
+    constructor(address _owner, address _implementation) {
+        owner = _owner;
+        _setImplementation(_implementation);
+    }
+
+    function upgradeTo(address _newImplementation) external {
+        require(msg.sender == owner, "StakeHelperBeacon: caller is not the owner");
+        _setImplementation(_newImplementation);
+    }
+
+    function _setImplementation(address _newImplementation) private {
+        require(_newImplementation.code.length > 0, "StakeHelperBeacon: implementation is not a contract");
+        implementation = _newImplementation;
+        emit Upgraded(_newImplementation);
+    }
+}
@@ -0,0 +1,50 @@
+// SPDX-License-Identifier: MIT
+
+pragma solidity ^0.8.18;
+
+interface IBeacon {
+    function implementation() external view returns (address);
+}
+
+// Beacon Proxy
+// Resolves its implementation from the beacon stored in the ERC1967 beacon slot on every call.
+contract BeaconProxy {
+
+    // bytes32(uint256(keccak256("eip1967.proxy.beacon")) - 1)
+    bytes32 internal constant _BEACON_SLOT = 0xa3f0ad74e5423aebfd80d3ef4346578335a9a72aeaee59ff6cb3582b35133d50;
+
+    event BeaconUpgraded(address indexed beacon);
+
+    constructor(address _beacon, bytes memory _data) payable {
+        require(_beacon.code.length > 0, "BeaconProxy: beacon is not a contract");
+        assembly {
+            sstore(_BEACON_SLOT, _beacon)
+        }
+        emit BeaconUpgraded(_beacon);
+
+        if (_data.length > 0) {
+            (bool success, bytes memory returndata) = IBeacon(_beacon).implementation().delegatecall(_data);
+            if (!success) {
+                assembly {
+                    revert(add(returndata, 32), mload(returndata))
+                }
+            }
+        }
+    }
+
+    fallback() external payable {
+        address beacon;
+        assembly {
+            beacon := sload(_BEACON_SLOT)
+        }
+        address impl = IBeacon(beacon).implementation();
+        assembly {
+            calldatacopy(0, 0, calldatasize())
+            let result := delegatecall(gas(), impl, 0, calldatasize(), 0, 0)
+            returndatacopy(0, 0, returndatasize())
+            switch result
+            case 0 { revert(0, returndatasize()) }
+            default { return(0, returndatasize()) }
+        }
+    }
+}
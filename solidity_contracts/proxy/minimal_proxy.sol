@@ -0,0 +1,44 @@
+// SPDX-License-Identifier: MIT
+
+pragma solidity ^0.8.18;
+
+// Minimal ERC1967 Proxy
+// Same constructor and storage layout as Erc20Proxy, without the library code.
+// The runtime only loads the implementation from the ERC1967 slot and delegates,
+// so UUPS upgrades of the implementation (upgradeToAndCall) keep working per proxy.
+contract MinimalProxy {
+
+    // bytes32(uint256(keccak256("eip1967.proxy.implementation")) - 1)
+    bytes32 internal constant _IMPLEMENTATION_SLOT = 0x360894a13ba1a3210667c828492db98dca3e2076cc3735a920a3ca505d382bbc;
+
+    event Upgraded(address indexed implementation);
+
+    constructor(address _logic, bytes memory _data) payable {
+        require(_logic.code.length > 0, "MinimalProxy: implementation is not a contract");
+        assembly {
+            sstore(_IMPLEMENTATION_SLOT, _logic)
+        }
+        emit Upgraded(_logic);
+
+        if (_data.length > 0) {
+            (bool success, bytes memory returndata) = _logic.delegatecall(_data);
+            if (!success) {
+                assembly {
+                    revert(add(returndata, 32), mload(returndata))
+                }
+            }
+        }
+    }
+
+    fallback() external payable {
+        assembly {
+            let impl := sload(_IMPLEMENTATION_SLOT)
+            calldatacopy(0, 0, calldatasize())
+            let result := delegatecall(gas(), impl, 0, calldatasize(), 0, 0)
+            returndatacopy(0, 0, returndatasize())
+            switch result
+            case 0 { revert(0, returndatasize()) }
+            default { return(0, returndatasize()) }
+        }
+    }
+}